@@ -1,9 +1,72 @@
 #include "BinaryFile.h"
+#include "PackArchive.h"
 #include <iostream>
 #include <fstream>
+#include <stdexcept>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
-void KEngineCore::BinaryFile::LoadFromFile(const std::string& filename, const std::string& extension)
+KEngineCore::BinaryFile::BinaryFile()
 {
+}
+
+KEngineCore::BinaryFile::~BinaryFile()
+{
+    Unload();
+}
+
+KEngineCore::BinaryFile::BinaryFile(BinaryFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+KEngineCore::BinaryFile& KEngineCore::BinaryFile::operator=(BinaryFile&& other) noexcept
+{
+    if (this != &other) {
+        Unload();
+        mFileContents = std::move(other.mFileContents);
+        mMappedContents = other.mMappedContents;
+        mMappedSize = other.mMappedSize;
+        mOwnsMapping = other.mOwnsMapping;
+        mBorrowedMapping = std::move(other.mBorrowedMapping);
+        other.mFileContents.clear();
+        other.mMappedContents = nullptr;
+        other.mMappedSize = 0;
+        other.mOwnsMapping = false;
+    }
+    return *this;
+}
+
+void KEngineCore::BinaryFile::LoadFromFile(const std::string& filename, const std::string& extension, LoadMode mode, AccessHint hint)
+{
+    Unload();
+    PackArchiveFile packed = PackArchive::FindMounted(filename + extension);
+    if (packed) {
+        if (mode == LoadMode::Mapped) {
+            mMappedContents = packed.GetData();
+            mMappedSize = packed.GetSize();
+            mOwnsMapping = false;
+            mBorrowedMapping = packed.GetMapping();
+            Advise(hint);
+        } else {
+            mFileContents.assign(packed.GetData(), packed.GetData() + packed.GetSize());
+        }
+        return;
+    }
+    if (mode == LoadMode::Mapped) {
+        MapFile(filename + extension);
+        Advise(hint);
+        return;
+    }
+
     std::ifstream file(filename + extension, std::ios::ate | std::ios::binary);
 
     if (!file.is_open()) {
@@ -18,13 +81,156 @@ void KEngineCore::BinaryFile::LoadFromFile(const std::string& filename, const st
     file.close();
 }
 
+void KEngineCore::BinaryFile::Unload()
+{
+    UnmapFile();
+    std::vector<char>().swap(mFileContents);
+}
+
 const void* KEngineCore::BinaryFile::GetContents() const
 {
+    if (mMappedContents != nullptr) {
+        return mMappedContents;
+    }
     return (void *)&mFileContents[0];
 }
 
 size_t KEngineCore::BinaryFile::GetSize() const
 {
+    if (mMappedContents != nullptr) {
+        return mMappedSize;
+    }
     return mFileContents.size();
 }
 
+bool KEngineCore::BinaryFile::IsMapped() const
+{
+    return mMappedContents != nullptr;
+}
+
+#ifdef _WIN32
+
+void KEngineCore::BinaryFile::MapFile(const std::string& path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("failed to open file!");
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        throw std::runtime_error("failed to size file!");
+    }
+    if (fileSize.QuadPart == 0) {
+        //Can't map nothing; an empty file just loads as empty
+        CloseHandle(file);
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void * view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    //The view keeps the mapping and file alive by itself
+    if (mapping != nullptr) {
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    if (view == nullptr) {
+        throw std::runtime_error("failed to map file!");
+    }
+    mMappedContents = (const char *)view;
+    mMappedSize = (size_t)fileSize.QuadPart;
+    mOwnsMapping = true;
+}
+
+void KEngineCore::BinaryFile::UnmapFile()
+{
+    if (mMappedContents != nullptr) {
+        if (mOwnsMapping) {
+            UnmapViewOfFile(mMappedContents);
+        }
+        mMappedContents = nullptr;
+        mMappedSize = 0;
+        mBorrowedMapping.reset();
+    }
+}
+
+void KEngineCore::BinaryFile::Advise(AccessHint hint) const
+{
+    //Windows only takes a prefetch request after the fact; read-ahead behaviour is fixed when the file is opened
+    if (mMappedContents != nullptr && hint == AccessHint::WillNeed) {
+        WIN32_MEMORY_RANGE_ENTRY range;
+        range.VirtualAddress = (PVOID)mMappedContents;
+        range.NumberOfBytes = mMappedSize;  //Needn't be page aligned, unlike madvise
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+}
+
+#else
+
+void KEngineCore::BinaryFile::MapFile(const std::string& path)
+{
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw std::runtime_error("failed to open file!");
+    }
+    struct stat status;
+    if (fstat(file, &status) != 0) {
+        close(file);
+        throw std::runtime_error("failed to size file!");
+    }
+    if (status.st_size == 0) {
+        //Can't map nothing; an empty file just loads as empty
+        close(file);
+        return;
+    }
+    void * mapping = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    //The mapping keeps the file alive by itself
+    close(file);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("failed to map file!");
+    }
+    mMappedContents = (const char *)mapping;
+    mMappedSize = (size_t)status.st_size;
+    mOwnsMapping = true;
+}
+
+void KEngineCore::BinaryFile::UnmapFile()
+{
+    if (mMappedContents != nullptr) {
+        if (mOwnsMapping) {
+            munmap((void *)mMappedContents, mMappedSize);
+        }
+        mMappedContents = nullptr;
+        mMappedSize = 0;
+        mBorrowedMapping.reset();
+    }
+}
+
+void KEngineCore::BinaryFile::Advise(AccessHint hint) const
+{
+    if (mMappedContents == nullptr) {
+        return;
+    }
+    int advice = MADV_NORMAL;
+    switch (hint) {
+        case AccessHint::Normal:
+            advice = MADV_NORMAL;
+            break;
+        case AccessHint::Sequential:
+            advice = MADV_SEQUENTIAL;
+            break;
+        case AccessHint::Random:
+            advice = MADV_RANDOM;
+            break;
+        case AccessHint::WillNeed:
+            advice = MADV_WILLNEED;
+            break;
+    }
+    //madvise wants a page aligned range, which contents borrowed from a PackArchive needn't start on
+    uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)mMappedContents & ~(pageSize - 1);
+    uintptr_t end = (uintptr_t)mMappedContents + mMappedSize;
+    //Only a hint, so failure isn't worth reporting
+    madvise((void *)begin, end - begin, advice);
+}
+
+#endif
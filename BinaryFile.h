@@ -6,6 +6,7 @@
 //
 
 #pragma once
+#include <memory>
 #include <string>
 #include <vector>
 #include <assert.h>
@@ -15,20 +16,58 @@ namespace KEngineCore
     class BinaryFile
     {
     public:
-        void LoadFromFile(const std::string& filename, const std::string& extension);
+        //Copy reads the whole file into memory up front.  Mapped maps it read-only instead, so loading is near
+        //instant, pages are read in as they're first touched, and the OS can drop them again under memory pressure.
+        //Files in a mounted PackArchive are found there first; Mapped then points into the archive's mapping.
+        enum class LoadMode
+        {
+            Copy,
+            Mapped
+        };
+
+        //How a mapped file is about to be read; ignored for copied files
+        enum class AccessHint
+        {
+            Normal,
+            Sequential,     //Read ahead aggressively and drop pages behind
+            Random,         //Don't read ahead
+            WillNeed        //Start reading the whole file in now
+        };
+
+        BinaryFile();
+        ~BinaryFile();
+        BinaryFile(const BinaryFile&) = delete;
+        BinaryFile& operator=(const BinaryFile&) = delete;
+        //Moving hands over the mapping, leaving the source unloaded
+        BinaryFile(BinaryFile&& other) noexcept;
+        BinaryFile& operator=(BinaryFile&& other) noexcept;
+
+        void LoadFromFile(const std::string& filename, const std::string& extension, LoadMode mode = LoadMode::Copy, AccessHint hint = AccessHint::Normal);
+        void Unload();
+        void Advise(AccessHint hint) const;
+
+        //Mapped contents stay valid until Unload, another LoadFromFile or destruction
         const void * GetContents() const;
         template<class DataType>
         const DataType* GetContents() const;
 
         size_t GetSize() const;
+        bool IsMapped() const;
     private:
+        void MapFile(const std::string& path);
+        void UnmapFile();
+
         std::vector<char> mFileContents;
+        const char * mMappedContents {nullptr};
+        size_t mMappedSize {0};
+        bool mOwnsMapping {false};    //False when the contents are borrowed from a PackArchive
+        std::shared_ptr<const void> mBorrowedMapping;  //The archive's mapping, kept alive while it's borrowed
     };
 
     template<class DataType>
     const DataType* KEngineCore::BinaryFile::GetContents() const
     {
         assert(GetSize() >= sizeof(DataType));
-        return reinterpret_cast<const DataType*>(&mFileContents[0]);
+        return reinterpret_cast<const DataType*>(GetContents());
     }
 }
@@ -0,0 +1,238 @@
+#pragma once
+
+#include "SlotMap.h"
+#include "WorkerPool.h"
+#include <functional>
+#include <vector>
+#include <cassert>
+
+
+namespace KEngineCore {
+
+	typedef SlotMapHandle ComponentHandle;
+
+	///------------------------------------------------------------------------
+	///------------------------------------------------------------------------
+
+	///Contiguous storage for plain components, updated a batch at a time instead of one virtual-ish call per object.
+	///An alternative to Updating<TClass> for large numbers of small objects: components live packed in one array, so
+	///an update is a linear walk rather than a pointer chase.
+	///
+	///Create and Destroy are O(1) and handles stay valid (or go detectably stale) however the array is rearranged.
+	///Destroying moves the last component into the hole, so component addresses and order are not stable; hold handles.
+	///Destroys made during Update are deferred until it finishes; creating during Update isn't allowed.
+	template <class TComponent>
+	class ComponentStore
+	{
+	public:
+		///Called with a run of components; may be a sub-range of the store when updating in parallel
+		typedef std::function<void (TComponent * components, size_t count, double time)> BatchFunction;
+
+		ComponentStore();
+		~ComponentStore();
+
+		void Init(BatchFunction batchUpdate = nullptr);
+		void Deinit();
+
+		template <class... TArgs>
+		ComponentHandle Create(TArgs &&... args);
+		void Destroy(ComponentHandle handle);
+
+		bool Contains(ComponentHandle handle) const;
+		TComponent * Get(ComponentHandle handle);
+		TComponent const * Get(ComponentHandle handle) const;
+
+		void Reserve(size_t capacity);
+		size_t GetCount() const;
+		TComponent * Data();
+		TComponent const * Data() const;
+		///The handle of the component at denseIndex in Data(); inside a batch, that's (components - Data()) + i
+		ComponentHandle GetHandle(size_t denseIndex) const;
+
+		void Update(double time);
+		///Spreads the batch across workerPool in runs of at least minChunkSize.  The batch function must be safe to run
+		///concurrently, and must not Destroy (collect handles with GetHandle and destroy them afterwards instead).
+		void Update(double time, WorkerPool * workerPool, size_t minChunkSize = 1024);
+
+	private:
+		void FinishUpdate();
+
+		SlotMap<TComponent>				mComponents;
+		std::vector<ComponentHandle>	mPendingDestroys;
+		BatchFunction					mBatchUpdate {nullptr};
+		bool							mUpdating {false};
+	};
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	ComponentStore<TComponent>::ComponentStore()
+	{
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	ComponentStore<TComponent>::~ComponentStore()
+	{
+		Deinit();
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	void ComponentStore<TComponent>::Init(BatchFunction batchUpdate)
+	{
+		mBatchUpdate = batchUpdate;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	void ComponentStore<TComponent>::Deinit()
+	{
+		assert(!mUpdating);
+		mComponents.Clear();
+		mPendingDestroys.clear();
+		mBatchUpdate = nullptr;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	template <class... TArgs>
+	ComponentHandle ComponentStore<TComponent>::Create(TArgs &&... args)
+	{
+		assert(!mUpdating);	///Would reallocate the array being updated
+		return mComponents.Emplace(std::forward<TArgs>(args)...);
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	void ComponentStore<TComponent>::Destroy(ComponentHandle handle)
+	{
+		if (mUpdating)
+		{
+			mPendingDestroys.push_back(handle);
+		}
+		else
+		{
+			mComponents.Erase(handle);
+		}
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	bool ComponentStore<TComponent>::Contains(ComponentHandle handle) const
+	{
+		return mComponents.Contains(handle);
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	TComponent * ComponentStore<TComponent>::Get(ComponentHandle handle)
+	{
+		return mComponents.Get(handle);
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	TComponent const * ComponentStore<TComponent>::Get(ComponentHandle handle) const
+	{
+		return mComponents.Get(handle);
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	void ComponentStore<TComponent>::Reserve(size_t capacity)
+	{
+		mComponents.Reserve(capacity);
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	size_t ComponentStore<TComponent>::GetCount() const
+	{
+		return mComponents.Size();
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	TComponent * ComponentStore<TComponent>::Data()
+	{
+		return mComponents.Data();
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	TComponent const * ComponentStore<TComponent>::Data() const
+	{
+		return mComponents.Data();
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	ComponentHandle ComponentStore<TComponent>::GetHandle(size_t denseIndex) const
+	{
+		return mComponents.GetHandle(denseIndex);
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	void ComponentStore<TComponent>::Update(double time)
+	{
+		assert(!mUpdating);
+		if (mBatchUpdate == nullptr || mComponents.Empty())
+		{
+			return;
+		}
+		mUpdating = true;
+		mBatchUpdate(mComponents.Data(), mComponents.Size(), time);
+		FinishUpdate();
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	void ComponentStore<TComponent>::Update(double time, WorkerPool * workerPool, size_t minChunkSize)
+	{
+		assert(!mUpdating);
+		if (mBatchUpdate == nullptr || mComponents.Empty())
+		{
+			return;
+		}
+		mUpdating = true;
+		TComponent * components = mComponents.Data();
+		BatchFunction const & batchUpdate = mBatchUpdate;
+		workerPool->ParallelFor(mComponents.Size(), minChunkSize, [components, &batchUpdate, time] (size_t begin, size_t end)
+			{
+				batchUpdate(components + begin, end - begin, time);
+			});
+		FinishUpdate();
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TComponent>
+	void ComponentStore<TComponent>::FinishUpdate()
+	{
+		mUpdating = false;
+		for (auto handle : mPendingDestroys)
+		{
+			mComponents.Erase(handle);
+		}
+		mPendingDestroys.clear();
+	}
+
+	///------------------------------------------------------------------------
+}
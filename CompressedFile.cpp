@@ -0,0 +1,183 @@
+#include "CompressedFile.h"
+#include "Lz4Block.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+KEngineCore::CompressedFile::CompressedFile()
+{
+}
+
+KEngineCore::CompressedFile::~CompressedFile()
+{
+    Unload();
+}
+
+void KEngineCore::CompressedFile::LoadFromFile(const std::string& filename, const std::string& extension)
+{
+    Unload();
+    //Blocks are read as they're decoded, which for a whole file decode is mostly front to back
+    mFile.LoadFromFile(filename, extension, BinaryFile::LoadMode::Mapped, BinaryFile::AccessHint::Sequential);
+
+    size_t fileSize = mFile.GetSize();
+    if (fileSize < sizeof(CompressedFileHeader)) {
+        Unload();
+        throw std::runtime_error("not a compressed file!");
+    }
+    memcpy(&mHeader, mFile.GetContents(), sizeof(mHeader));
+    uint64_t expectedBlocks = mHeader.mBlockSize != 0 ? (mHeader.mSize + mHeader.mBlockSize - 1) / mHeader.mBlockSize : 0;
+    if (memcmp(mHeader.mMagic, "KBLK", 4) != 0 || mHeader.mVersion != kVersion || mHeader.mBlockSize == 0 ||
+        mHeader.mBlockCount != expectedBlocks ||
+        mHeader.mBlockCount > (fileSize - sizeof(CompressedFileHeader)) / sizeof(CompressedFileBlock)) {
+        Unload();
+        throw std::runtime_error("not a compressed file!");
+    }
+    for (size_t block = 0; block < mHeader.mBlockCount; block++) {
+        CompressedFileBlock entry = GetBlock(block);
+        if (entry.mOffset > fileSize || entry.mStoredSize > fileSize - entry.mOffset) {
+            Unload();
+            throw std::runtime_error("corrupt compressed file!");
+        }
+    }
+}
+
+void KEngineCore::CompressedFile::Unload()
+{
+    mFile.Unload();
+    mHeader = CompressedFileHeader();
+    std::vector<char>().swap(mContents);
+    mDecoded = false;
+}
+
+size_t KEngineCore::CompressedFile::GetSize() const
+{
+    return (size_t)mHeader.mSize;
+}
+
+size_t KEngineCore::CompressedFile::GetBlockSize() const
+{
+    return mHeader.mBlockSize;
+}
+
+size_t KEngineCore::CompressedFile::GetBlockCount() const
+{
+    return mHeader.mBlockCount;
+}
+
+size_t KEngineCore::CompressedFile::GetBlockDecodedSize(size_t block) const
+{
+    assert(block < mHeader.mBlockCount);
+    size_t start = block * (size_t)mHeader.mBlockSize;
+    return std::min((size_t)mHeader.mBlockSize, (size_t)mHeader.mSize - start);
+}
+
+void KEngineCore::CompressedFile::DecodeBlock(size_t block, void * destination) const
+{
+    CompressedFileBlock entry = GetBlock(block);
+    size_t decodedSize = GetBlockDecodedSize(block);
+    const char * stored = (const char *)mFile.GetContents() + entry.mOffset;
+    if (entry.mStoredSize == decodedSize) {
+        memcpy(destination, stored, decodedSize);  //Didn't compress, so it was stored raw
+        return;
+    }
+    if (Lz4BlockDecompress(stored, entry.mStoredSize, destination, decodedSize) != decodedSize) {
+        throw std::runtime_error("corrupt compressed block!");
+    }
+}
+
+void KEngineCore::CompressedFile::DecodeBlocks(size_t firstBlock, size_t blockCount, void * destination, WorkerPool * workerPool) const
+{
+    assert(firstBlock + blockCount <= mHeader.mBlockCount);
+    char * output = (char *)destination;
+    if (workerPool == nullptr || blockCount < 2) {
+        for (size_t block = firstBlock; block < firstBlock + blockCount; block++) {
+            DecodeBlock(block, output);
+            output += GetBlockDecodedSize(block);
+        }
+        return;
+    }
+
+    //Every block but the last is full size, so each one's place in the output is known up front.  Exceptions can't
+    //cross the pool's threads, so a failure is noted and thrown once the pass is over.
+    std::atomic<bool> failed {false};
+    size_t blockSize = mHeader.mBlockSize;
+    workerPool->ParallelFor(blockCount, 1, [this, firstBlock, output, blockSize, &failed] (size_t begin, size_t end)
+        {
+            for (size_t index = begin; index < end && !failed; index++) {
+                try {
+                    DecodeBlock(firstBlock + index, output + index * blockSize);
+                } catch (std::runtime_error &) {
+                    failed = true;
+                }
+            }
+        });
+    if (failed) {
+        throw std::runtime_error("corrupt compressed block!");
+    }
+}
+
+void KEngineCore::CompressedFile::Decode(WorkerPool * workerPool)
+{
+    if (mDecoded) {
+        return;
+    }
+    mContents.resize((size_t)mHeader.mSize);
+    DecodeBlocks(0, mHeader.mBlockCount, mContents.data(), workerPool);
+    mDecoded = true;
+}
+
+bool KEngineCore::CompressedFile::IsDecoded() const
+{
+    return mDecoded;
+}
+
+const void* KEngineCore::CompressedFile::GetContents() const
+{
+    assert(mDecoded);
+    return (void *)mContents.data();
+}
+
+KEngineCore::CompressedFileBlock KEngineCore::CompressedFile::GetBlock(size_t block) const
+{
+    assert(block < mHeader.mBlockCount);
+    CompressedFileBlock entry;
+    memcpy(&entry, (const char *)mFile.GetContents() + sizeof(CompressedFileHeader) + block * sizeof(CompressedFileBlock), sizeof(entry));
+    return entry;
+}
+
+void KEngineCore::CompressedFile::Compress(const void * data, size_t size, std::vector<char>& output, uint32_t blockSize)
+{
+    assert(blockSize > 0);
+    CompressedFileHeader header;
+    memcpy(header.mMagic, "KBLK", 4);
+    header.mVersion = kVersion;
+    header.mBlockSize = blockSize;
+    header.mBlockCount = (uint32_t)((size + blockSize - 1) / blockSize);
+    header.mSize = size;
+
+    size_t tableSize = header.mBlockCount * sizeof(CompressedFileBlock);
+    output.resize(sizeof(header) + tableSize);
+    memcpy(output.data(), &header, sizeof(header));
+
+    std::vector<char> scratch(Lz4BlockBound(blockSize));
+    const char * input = (const char *)data;
+    for (uint32_t block = 0; block < header.mBlockCount; block++) {
+        size_t start = (size_t)block * blockSize;
+        size_t decodedSize = std::min((size_t)blockSize, size - start);
+        size_t storedSize = Lz4BlockCompress(input + start, decodedSize, scratch.data(), scratch.size());
+        const char * stored = scratch.data();
+        if (storedSize == 0 || storedSize >= decodedSize) {
+            //Not worth it; store raw, which also keeps the block's stored size from exceeding its decoded size
+            storedSize = decodedSize;
+            stored = input + start;
+        }
+        CompressedFileBlock entry;
+        entry.mOffset = output.size();
+        entry.mStoredSize = (uint32_t)storedSize;
+        entry.mReserved = 0;
+        memcpy(output.data() + sizeof(header) + block * sizeof(CompressedFileBlock), &entry, sizeof(entry));
+        output.insert(output.end(), stored, stored + storedSize);
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "BinaryFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <assert.h>
+
+namespace KEngineCore
+{
+    class WorkerPool;
+
+    //On-disk layout, all little endian: a header, a table of blocks, then the blocks.  Every block but the last
+    //decodes to exactly mBlockSize bytes.  A block whose stored size equals its decoded size is stored raw.
+    struct CompressedFileHeader
+    {
+        char        mMagic[4];      //"KBLK"
+        uint32_t    mVersion;
+        uint32_t    mBlockSize;
+        uint32_t    mBlockCount;
+        uint64_t    mSize;          //Decoded size of the whole file
+    };
+
+    struct CompressedFileBlock
+    {
+        uint64_t    mOffset;        //From the start of the file
+        uint32_t    mStoredSize;
+        uint32_t    mReserved;
+    };
+
+    //A file compressed in independent blocks (LZ4 block format, 64KB by default), so any block can be decoded on
+    //its own: for random access, for streaming into a caller's buffer a block at a time, or for decoding many
+    //blocks across a WorkerPool at once.  The compressed file itself is mapped, through a PackArchive if mounted.
+    //
+    //Decode unpacks the whole file into memory, after which GetContents works as it does for BinaryFile.
+    //Corrupt data throws std::runtime_error, as a missing file does.
+    class CompressedFile
+    {
+    public:
+        static constexpr uint32_t kVersion = 1;
+        static constexpr uint32_t kDefaultBlockSize = 64 * 1024;
+
+        CompressedFile();
+        ~CompressedFile();
+        CompressedFile(const CompressedFile&) = delete;
+        CompressedFile& operator=(const CompressedFile&) = delete;
+
+        void LoadFromFile(const std::string& filename, const std::string& extension);
+        void Unload();
+
+        //Decoded sizes
+        size_t GetSize() const;
+        size_t GetBlockSize() const;
+        size_t GetBlockCount() const;
+        size_t GetBlockDecodedSize(size_t block) const;
+
+        //destination must hold GetBlockDecodedSize(block) bytes.  Safe to call from several threads at once.
+        void DecodeBlock(size_t block, void * destination) const;
+        //Decodes blockCount blocks from firstBlock into destination back to back, spread across workerPool if given
+        void DecodeBlocks(size_t firstBlock, size_t blockCount, void * destination, WorkerPool * workerPool = nullptr) const;
+
+        //Decodes everything into memory for GetContents
+        void Decode(WorkerPool * workerPool = nullptr);
+        bool IsDecoded() const;
+        const void * GetContents() const;
+        template<class DataType>
+        const DataType* GetContents() const;
+
+        //Builds a compressed file's bytes from data, for tools and the asset pipeline
+        static void Compress(const void * data, size_t size, std::vector<char>& output, uint32_t blockSize = kDefaultBlockSize);
+
+    private:
+        CompressedFileBlock GetBlock(size_t block) const;
+
+        BinaryFile mFile;
+        CompressedFileHeader mHeader {};
+        std::vector<char> mContents;
+        bool mDecoded {false};
+    };
+
+    template<class DataType>
+    const DataType* KEngineCore::CompressedFile::GetContents() const
+    {
+        assert(GetSize() >= sizeof(DataType));
+        return reinterpret_cast<const DataType*>(GetContents());
+    }
+}
@@ -0,0 +1,43 @@
+#include "Crc32.h"
+#include <cstring>
+
+namespace {
+
+	constexpr KEngineCore::CrcDetail::SliceTables<uint32_t, KEngineCore::Crc32Detail::kPolynomial> kSlices {};
+
+}
+
+uint32_t KEngineCore::Crc32Fast(char const * data, size_t length)
+{
+	auto const & table = kSlices.mEntries;
+	unsigned char const * bytes = (unsigned char const *)data;
+	uint32_t crc = 0xFFFFFFFFu;
+
+	//Byte at a time up to an 8 byte boundary, so the main loop's loads are aligned
+	while (length > 0 && ((uintptr_t)bytes & 7) != 0)
+	{
+		crc = (crc >> 8) ^ table[0][(crc ^ *bytes++) & 0xFF];
+		length--;
+	}
+
+	//Every platform we ship on is little endian, which the word order below assumes
+	while (length >= 8)
+	{
+		uint32_t low;
+		uint32_t high;
+		memcpy(&low, bytes, 4);
+		memcpy(&high, bytes + 4, 4);
+		low ^= crc;
+		crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+			table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^ table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+		bytes += 8;
+		length -= 8;
+	}
+
+	while (length > 0)
+	{
+		crc = (crc >> 8) ^ table[0][(crc ^ *bytes++) & 0xFF];
+		length--;
+	}
+	return crc ^ 0xFFFFFFFFu;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "CrcTable.h"
+
+
+namespace KEngineCore {
+
+	///------------------------------------------------------------------------
+	///------------------------------------------------------------------------
+
+	///The standard reflected CRC-32 (polynomial 0xEDB88320, initial and final xor 0xFFFFFFFF), matching boost::crc_32_type.
+	///Everything here is constexpr so hashes of literals can be folded at compile time; runtime callers get the same answer.
+	namespace Crc32Detail {
+
+		constexpr uint32_t kPolynomial = 0xEDB88320u;
+
+		///Built once at compile time
+		constexpr CrcDetail::Table<uint32_t, kPolynomial> kTable {};
+
+	}
+
+	///------------------------------------------------------------------------
+
+	constexpr uint32_t Crc32(char const * data, size_t length)
+	{
+		return CrcDetail::Compute(Crc32Detail::kTable, data, length);
+	}
+
+	///------------------------------------------------------------------------
+
+	///Null-terminated overload
+	constexpr uint32_t Crc32(char const * string)
+	{
+		return Crc32(string, CrcDetail::Length(string));
+	}
+
+	///------------------------------------------------------------------------
+
+	///Same result as Crc32, but for strings only known at runtime: slicing-by-8, several times faster than the byte loop
+	uint32_t Crc32Fast(char const * data, size_t length);
+
+	///------------------------------------------------------------------------
+}
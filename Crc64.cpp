@@ -0,0 +1,40 @@
+#include "Crc64.h"
+#include <cstring>
+
+namespace {
+
+	constexpr KEngineCore::CrcDetail::SliceTables<uint64_t, KEngineCore::Crc64Detail::kPolynomial> kSlices {};
+
+}
+
+uint64_t KEngineCore::Crc64Fast(char const * data, size_t length)
+{
+	auto const & table = kSlices.mEntries;
+	unsigned char const * bytes = (unsigned char const *)data;
+	uint64_t crc = ~0ull;
+
+	while (length > 0 && ((uintptr_t)bytes & 7) != 0)
+	{
+		crc = (crc >> 8) ^ table[0][(crc ^ *bytes++) & 0xFF];
+		length--;
+	}
+
+	//Little endian, as in Crc32Fast
+	while (length >= 8)
+	{
+		uint64_t word;
+		memcpy(&word, bytes, 8);
+		word ^= crc;
+		crc = table[7][word & 0xFF] ^ table[6][(word >> 8) & 0xFF] ^ table[5][(word >> 16) & 0xFF] ^ table[4][(word >> 24) & 0xFF] ^
+			table[3][(word >> 32) & 0xFF] ^ table[2][(word >> 40) & 0xFF] ^ table[1][(word >> 48) & 0xFF] ^ table[0][word >> 56];
+		bytes += 8;
+		length -= 8;
+	}
+
+	while (length > 0)
+	{
+		crc = (crc >> 8) ^ table[0][(crc ^ *bytes++) & 0xFF];
+		length--;
+	}
+	return ~crc;
+}
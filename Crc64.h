@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "CrcTable.h"
+
+
+namespace KEngineCore {
+
+	///------------------------------------------------------------------------
+	///------------------------------------------------------------------------
+
+	///CRC-64/XZ: reflected, polynomial 0xC96C5795D7870F42 (ECMA-182), initial and final xor all ones.  The 64 bit
+	///counterpart of Crc32, for when a table is big enough that 32 bit collisions become likely.
+	namespace Crc64Detail {
+
+		constexpr uint64_t kPolynomial = 0xC96C5795D7870F42ull;
+
+		///Built once at compile time
+		constexpr CrcDetail::Table<uint64_t, kPolynomial> kTable {};
+
+	}
+
+	///------------------------------------------------------------------------
+
+	constexpr uint64_t Crc64(char const * data, size_t length)
+	{
+		return CrcDetail::Compute(Crc64Detail::kTable, data, length);
+	}
+
+	///------------------------------------------------------------------------
+
+	///Null-terminated overload
+	constexpr uint64_t Crc64(char const * string)
+	{
+		return Crc64(string, CrcDetail::Length(string));
+	}
+
+	///------------------------------------------------------------------------
+
+	///Same result as Crc64, slicing-by-8 for strings only known at runtime
+	uint64_t Crc64Fast(char const * data, size_t length);
+
+	///------------------------------------------------------------------------
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+
+namespace KEngineCore {
+
+	///------------------------------------------------------------------------
+	///------------------------------------------------------------------------
+
+	///Table generation shared by the reflected CRCs (Crc32, Crc64), which differ only in width and polynomial.
+	///Everything is constexpr, so the tables are built at compile time.
+	namespace CrcDetail {
+
+		///Entry b is the CRC of the single byte b
+		template <class TCrc, TCrc kPolynomial>
+		struct Table
+		{
+			TCrc mEntries[256] {};
+
+			constexpr Table()
+			{
+				for (uint32_t index = 0; index < 256; index++)
+				{
+					TCrc crc = index;
+					for (int bit = 0; bit < 8; bit++)
+					{
+						crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : TCrc(0));
+					}
+					mEntries[index] = crc;
+				}
+			}
+		};
+
+		///------------------------------------------------------------------------
+
+		///Slicing-by-8 tables for the runtime kernels: entry [k][b] is the CRC of byte b followed by k zero bytes, so
+		///eight table lookups advance the CRC over eight bytes at once instead of one lookup per byte
+		template <class TCrc, TCrc kPolynomial>
+		struct SliceTables
+		{
+			TCrc mEntries[8][256] {};
+
+			constexpr SliceTables()
+			{
+				Table<TCrc, kPolynomial> single;
+				for (uint32_t index = 0; index < 256; index++)
+				{
+					mEntries[0][index] = single.mEntries[index];
+				}
+				for (int slice = 1; slice < 8; slice++)
+				{
+					for (uint32_t index = 0; index < 256; index++)
+					{
+						TCrc previous = mEntries[slice - 1][index];
+						mEntries[slice][index] = (previous >> 8) ^ mEntries[0][previous & 0xFF];
+					}
+				}
+			}
+		};
+
+		///------------------------------------------------------------------------
+
+		///The byte at a time loop, initial and final xor all ones
+		template <class TCrc, TCrc kPolynomial>
+		constexpr TCrc Compute(Table<TCrc, kPolynomial> const & table, char const * data, size_t length)
+		{
+			TCrc crc = ~TCrc(0);
+			for (size_t index = 0; index < length; index++)
+			{
+				crc = (crc >> 8) ^ table.mEntries[(crc ^ (unsigned char)data[index]) & 0xFF];
+			}
+			return ~crc;
+		}
+
+		///------------------------------------------------------------------------
+
+		constexpr size_t Length(char const * string)
+		{
+			size_t length = 0;
+			while (string[length] != '\0')
+			{
+				length++;
+			}
+			return length;
+		}
+
+	}
+
+	///------------------------------------------------------------------------
+}
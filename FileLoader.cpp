@@ -0,0 +1,316 @@
+#include "FileLoader.h"
+#include "LuaScheduler.h"
+#include "PackArchive.h"
+#include <assert.h>
+#include <algorithm>
+#include <fstream>
+
+static const size_t kLatencySamples = 1024;
+
+KEngineCore::FileLoader::FileLoader()
+{
+}
+
+KEngineCore::FileLoader::~FileLoader()
+{
+	Deinit();
+}
+
+void KEngineCore::FileLoader::Init(LuaScheduler * scheduler, unsigned int threadCount)
+{
+	assert(mThreads.empty());
+	assert(threadCount > 0);
+	mScheduler = scheduler;
+	if (scheduler != nullptr) {
+		RegisterLibrary(scheduler->GetMainState());
+	}
+	mQuitting = false;
+	mLatencies.reserve(kLatencySamples);
+	for (unsigned int index = 0; index < threadCount; index++) {
+		mThreads.emplace_back(&FileLoader::IOThreadMain, this);
+	}
+}
+
+void KEngineCore::FileLoader::Deinit()
+{
+	if (mThreads.empty()) {
+		return;
+	}
+	std::deque<Request> requests;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuitting = true;
+		requests.swap(mRequests);
+	}
+	mRequestReady.notify_all();
+	for (auto it = mThreads.begin(); it != mThreads.end(); it++) {
+		it->join();
+	}
+	mThreads.clear();
+
+	//Nothing queued will be read now; futures still have to be satisfied, and parked threads let go of
+	for (auto it = requests.begin(); it != requests.end(); it++) {
+		if (it->mHasPromise) {
+			FileLoadResult result;
+			result.mPath = it->mPath;
+			it->mPromise.set_value(std::move(result));
+		}
+		if (it->mThreadRef != -1) {
+			luaL_unref(mScheduler->GetMainState(), LUA_REGISTRYINDEX, it->mThreadRef);
+		}
+	}
+	for (auto it = mCompletions.begin(); it != mCompletions.end(); it++) {
+		if (it->mThreadRef != -1) {
+			luaL_unref(mScheduler->GetMainState(), LUA_REGISTRYINDEX, it->mThreadRef);
+		}
+	}
+	mCompletions.clear();
+	mScheduler = nullptr;
+}
+
+std::future<KEngineCore::FileLoadResult> KEngineCore::FileLoader::Load(std::string const & path)
+{
+	Request request;
+	request.mPath = path;
+	request.mHasPromise = true;
+	std::future<FileLoadResult> future = request.mPromise.get_future();
+	Queue(std::move(request));
+	return future;
+}
+
+void KEngineCore::FileLoader::Load(std::string const & path, Callback callback)
+{
+	Request request;
+	request.mPath = path;
+	request.mCallback = callback;
+	Queue(std::move(request));
+}
+
+void KEngineCore::FileLoader::Load(std::string const & path, lua_State * thread)
+{
+	assert(mScheduler != nullptr);
+	ScheduledLuaThread * scheduledThread = mScheduler->GetScheduledThread(thread);
+	assert(scheduledThread != nullptr);
+	scheduledThread->Pause();
+	Request request;
+	request.mPath = path;
+	lua_checkstack(thread, 1);
+	lua_pushthread(thread);
+	request.mThreadRef = luaL_ref(thread, LUA_REGISTRYINDEX);  //Keeps the thread alive while it waits
+	Queue(std::move(request));
+}
+
+void KEngineCore::FileLoader::Queue(Request && request)
+{
+	assert(!mThreads.empty());  //Initialized
+	request.mQueued = std::chrono::steady_clock::now();
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mRequests.push_back(std::move(request));
+		mPeakQueueDepth = std::max(mPeakQueueDepth, mRequests.size());
+	}
+	mRequestReady.notify_one();
+}
+
+void KEngineCore::FileLoader::IOThreadMain()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (true) {
+		mRequestReady.wait(lock, [this] { return mQuitting || !mRequests.empty(); });
+		if (mQuitting) {
+			return;
+		}
+		Request request = std::move(mRequests.front());
+		mRequests.pop_front();
+		mInFlight++;
+		lock.unlock();
+
+		FileLoadResult result;
+		result.mPath = request.mPath;
+		std::ifstream file;
+		PackArchiveFile packed = PackArchive::FindMounted(request.mPath);
+		if (packed) {
+			result.mContents.assign(packed.GetData(), packed.GetData() + packed.GetSize());
+			result.mSucceeded = true;
+		} else {
+			file.open(request.mPath, std::ios::ate | std::ios::binary);
+		}
+		if (file.is_open()) {
+			size_t fileSize = (size_t)file.tellg();
+			result.mContents.resize(fileSize);
+			file.seekg(0);
+			file.read(result.mContents.data(), fileSize);
+			result.mSucceeded = !file.fail();
+			if (!result.mSucceeded) {
+				result.mContents.clear();
+			}
+		}
+		result.mLatency = std::chrono::duration<double>(std::chrono::steady_clock::now() - request.mQueued).count();
+
+		lock.lock();
+		mInFlight--;
+		RecordLatency(result.mLatency, result.mSucceeded);
+		if (request.mHasPromise) {
+			request.mPromise.set_value(std::move(result));
+		} else {
+			Completion completion;
+			completion.mResult = std::move(result);
+			completion.mCallback = std::move(request.mCallback);
+			completion.mThreadRef = request.mThreadRef;
+			mCompletions.push_back(std::move(completion));
+		}
+	}
+}
+
+void KEngineCore::FileLoader::Update()
+{
+	std::vector<Completion> completions;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		completions.swap(mCompletions);
+	}
+	for (auto it = completions.begin(); it != completions.end(); it++) {
+		if (it->mCallback != nullptr) {
+			it->mCallback(it->mResult);
+		}
+		if (it->mThreadRef != -1) {
+			ResumeThread(it->mThreadRef, it->mResult);
+		}
+	}
+}
+
+void KEngineCore::FileLoader::ResumeThread(int threadRef, FileLoadResult & result)
+{
+	lua_State * mainState = mScheduler->GetMainState();
+	lua_checkstack(mainState, 1);
+	lua_rawgeti(mainState, LUA_REGISTRYINDEX, threadRef);
+	lua_State * threadState = lua_tothread(mainState, -1);
+	lua_pop(mainState, 1);
+	luaL_unref(mainState, LUA_REGISTRYINDEX, threadRef);
+
+	ScheduledLuaThread * thread = mScheduler->GetScheduledThread(threadState);
+	if (thread == nullptr) {
+		return;  //Killed while it waited
+	}
+	lua_checkstack(threadState, 2);
+	if (result.mSucceeded) {
+		lua_pushlstring(threadState, result.mContents.data(), result.mContents.size());
+		thread->Resume(1);
+	} else {
+		lua_pushnil(threadState);
+		lua_pushfstring(threadState, "Unable to open file %s", result.mPath.c_str());
+		thread->Resume(2);
+	}
+}
+
+void KEngineCore::FileLoader::RecordLatency(double latency, bool succeeded)
+{
+	if (succeeded) {
+		mCompleted++;
+	} else {
+		mFailed++;
+	}
+	if (mLatencies.size() < kLatencySamples) {
+		mLatencies.push_back(latency);
+	} else {
+		mLatencies[mNextLatency] = latency;
+	}
+	mNextLatency = (mNextLatency + 1) % kLatencySamples;
+}
+
+KEngineCore::FileLoaderStats KEngineCore::FileLoader::GetStats() const
+{
+	FileLoaderStats stats;
+	std::vector<double> latencies;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		stats.mQueueDepth = mRequests.size();
+		stats.mPeakQueueDepth = mPeakQueueDepth;
+		stats.mInFlight = mInFlight;
+		stats.mCompleted = mCompleted;
+		stats.mFailed = mFailed;
+		latencies = mLatencies;
+	}
+	if (!latencies.empty()) {
+		std::sort(latencies.begin(), latencies.end());
+		auto percentile = [&latencies] (double fraction) {
+			return latencies[std::min(latencies.size() - 1, (size_t)(fraction * latencies.size()))];
+		};
+		stats.mLatency50 = percentile(0.5);
+		stats.mLatency90 = percentile(0.9);
+		stats.mLatency99 = percentile(0.99);
+		stats.mLatencyMax = latencies.back();
+	}
+	return stats;
+}
+
+void KEngineCore::FileLoader::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mPeakQueueDepth = mRequests.size();
+	mCompleted = 0;
+	mFailed = 0;
+	mLatencies.clear();
+	mNextLatency = 0;
+}
+
+static int load(lua_State * luaState) {
+	KEngineCore::FileLoader * loader = (KEngineCore::FileLoader *)lua_touserdata(luaState, lua_upvalueindex(1));
+	KEngineCore::LuaScheduler * scheduler = loader->GetLuaScheduler();
+	char const * path = luaL_checkstring(luaState, 1);
+	if (scheduler->GetScheduledThread(luaState) == nullptr) {
+		return luaL_error(luaState, "load called outside of a scheduled thread");
+	}
+	loader->Load(path, luaState);
+	return lua_yield(luaState, 0);  //Resumed with the contents, or nil and an error
+}
+
+static int stats(lua_State * luaState) {
+	KEngineCore::FileLoader * loader = (KEngineCore::FileLoader *)lua_touserdata(luaState, lua_upvalueindex(1));
+	KEngineCore::FileLoaderStats stats = loader->GetStats();
+	lua_checkstack(luaState, 2);
+	lua_createtable(luaState, 0, 9);
+	lua_pushunsigned(luaState, (lua_Unsigned)stats.mQueueDepth);
+	lua_setfield(luaState, -2, "queued");
+	lua_pushunsigned(luaState, (lua_Unsigned)stats.mPeakQueueDepth);
+	lua_setfield(luaState, -2, "peakQueued");
+	lua_pushunsigned(luaState, (lua_Unsigned)stats.mInFlight);
+	lua_setfield(luaState, -2, "inFlight");
+	lua_pushunsigned(luaState, (lua_Unsigned)stats.mCompleted);
+	lua_setfield(luaState, -2, "completed");
+	lua_pushunsigned(luaState, (lua_Unsigned)stats.mFailed);
+	lua_setfield(luaState, -2, "failed");
+	lua_pushnumber(luaState, stats.mLatency50);
+	lua_setfield(luaState, -2, "p50");
+	lua_pushnumber(luaState, stats.mLatency90);
+	lua_setfield(luaState, -2, "p90");
+	lua_pushnumber(luaState, stats.mLatency99);
+	lua_setfield(luaState, -2, "p99");
+	lua_pushnumber(luaState, stats.mLatencyMax);
+	lua_setfield(luaState, -2, "max");
+	return 1;
+}
+
+static const struct luaL_Reg fileLibrary [] = {
+	{"load", load},
+	{"stats", stats},
+	{nullptr, nullptr}
+};
+
+static int luaopen_file (lua_State * luaState) {
+	lua_checkstack(luaState, 2);
+	luaL_newlibtable(luaState, fileLibrary);
+	lua_pushvalue(luaState, lua_upvalueindex(1));
+	luaL_setfuncs(luaState, fileLibrary, 1);
+	return 1;
+};
+
+KEngineCore::LuaScheduler * KEngineCore::FileLoader::GetLuaScheduler() const
+{
+	return mScheduler;
+}
+
+void KEngineCore::FileLoader::RegisterLibrary(lua_State * luaState, char const * name)
+{
+	PreloadLibrary(luaState, name, luaopen_file);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "LuaLibrary.h"
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include <functional>
+
+namespace KEngineCore {
+
+class LuaScheduler;
+
+struct FileLoadResult {
+	std::string			mPath;
+	std::vector<char>	mContents;
+	bool				mSucceeded {false};
+	double				mLatency {0.0};	///Seconds from the request to the read finishing
+};
+
+struct FileLoaderStats {
+	size_t	mQueueDepth {0};		///Requests waiting for an IO thread right now
+	size_t	mPeakQueueDepth {0};	///Since Init or the last ResetStats
+	size_t	mInFlight {0};			///Requests being read right now
+	size_t	mCompleted {0};
+	size_t	mFailed {0};
+	///Over the most recent loads
+	double	mLatency50 {0.0};
+	double	mLatency90 {0.0};
+	double	mLatency99 {0.0};
+	double	mLatencyMax {0.0};
+};
+
+///Reads whole files on a small pool of background IO threads, so loading doesn't stall the frame.
+///
+///Load with a future to block (or poll) wherever suits, or with a callback, which is run from Update on the thread
+///calling it, so callbacks can touch game and Lua state freely.  With a scheduler, scripts get file.load(path),
+///which parks the calling thread the way timer.waits does and resumes it with the contents (or nil and an error)
+///in the Update after the read completes.
+///
+///Deinit (before the scheduler's) drops whatever hasn't been delivered: futures get a failed result, and pending
+///callbacks and parked threads are not run.
+class FileLoader : protected LuaLibrary
+{
+public:
+	typedef std::function<void (FileLoadResult & result)> Callback;
+
+	FileLoader();
+	~FileLoader();
+
+	///scheduler may be null when only the C++ interface is wanted
+	void Init(LuaScheduler * scheduler, unsigned int threadCount = 2);
+	void Deinit();
+
+	void RegisterLibrary(lua_State * luaState, char const * name = "file") override;
+	LuaScheduler * GetLuaScheduler() const;
+
+	std::future<FileLoadResult> Load(std::string const & path);
+	void Load(std::string const & path, Callback callback);
+	///Parks thread until path is read, then resumes it with the contents or nil and an error message
+	void Load(std::string const & path, lua_State * thread);
+
+	///Runs the callbacks and resumes the threads of loads finished since the last Update
+	void Update();
+
+	FileLoaderStats GetStats() const;
+	void ResetStats();
+
+private:
+	struct Request {
+		std::string								mPath;
+		std::chrono::steady_clock::time_point	mQueued;
+		std::promise<FileLoadResult>			mPromise;
+		Callback								mCallback {nullptr};
+		int										mThreadRef {-1};	///Registry reference to a parked Lua thread
+		bool									mHasPromise {false};
+	};
+
+	struct Completion {
+		FileLoadResult	mResult;
+		Callback		mCallback {nullptr};
+		int				mThreadRef {-1};
+	};
+
+	void Queue(Request && request);
+	void IOThreadMain();
+	void ResumeThread(int threadRef, FileLoadResult & result);
+	void RecordLatency(double latency, bool succeeded);
+
+	LuaScheduler *				mScheduler {nullptr};
+	std::vector<std::thread>	mThreads;
+
+	mutable std::mutex			mMutex;
+	std::condition_variable		mRequestReady;
+	std::deque<Request>			mRequests;
+	std::vector<Completion>		mCompletions;
+	bool						mQuitting {false};
+
+	size_t						mPeakQueueDepth {0};
+	size_t						mInFlight {0};
+	size_t						mCompleted {0};
+	size_t						mFailed {0};
+	std::vector<double>			mLatencies;		///Ring of recent latencies for the percentiles
+	size_t						mNextLatency {0};
+};
+
+}
@@ -0,0 +1,88 @@
+#include "FixedTimestep.h"
+#include "Timer.h"
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+
+static void stepTimer(void * object, double stepTime) {
+	((KEngineCore::Timer *)object)->Update(stepTime);
+}
+
+KEngineCore::FixedTimestep::FixedTimestep()
+{
+}
+
+KEngineCore::FixedTimestep::~FixedTimestep()
+{
+	Deinit();
+}
+
+void KEngineCore::FixedTimestep::Init(double stepTime, unsigned int maxStepsPerFrame)
+{
+	assert(stepTime > 0.0);
+	assert(maxStepsPerFrame > 0);
+	mStepTime = stepTime;
+	mMaxStepsPerFrame = maxStepsPerFrame;
+	mAccumulator = 0.0;
+	mDroppedTime = 0.0;
+}
+
+void KEngineCore::FixedTimestep::Deinit()
+{
+	mSteppers.clear();
+}
+
+void KEngineCore::FixedTimestep::Add(Timer * timer)
+{
+	//A timer has to see every step to keep its clock, but an empty one advances in constant time anyway
+	Add(timer, stepTimer, nullptr);
+}
+
+void KEngineCore::FixedTimestep::Add(void * object, StepFunction step, EmptyFunction isEmpty)
+{
+	assert(step != nullptr);
+	Stepper stepper = {object, step, isEmpty};
+	mSteppers.push_back(stepper);
+}
+
+void KEngineCore::FixedTimestep::Remove(void * object)
+{
+	mSteppers.erase(std::remove_if(mSteppers.begin(), mSteppers.end(), [object] (Stepper const & stepper) { return stepper.mObject == object; }), mSteppers.end());
+}
+
+unsigned int KEngineCore::FixedTimestep::Update(double elapsed)
+{
+	mAccumulator += elapsed;
+	unsigned int steps = 0;
+	while (mAccumulator >= mStepTime && steps < mMaxStepsPerFrame) {
+		for (auto it = mSteppers.begin(); it != mSteppers.end(); it++) {
+			if (it->mIsEmpty == nullptr || !it->mIsEmpty(it->mObject)) {
+				it->mStep(it->mObject, mStepTime);
+			}
+		}
+		mAccumulator -= mStepTime;
+		steps++;
+	}
+	if (mAccumulator >= mStepTime) {
+		//Hit the cap; keep only the partial step so the next frame starts fresh instead of further behind
+		double kept = std::fmod(mAccumulator, mStepTime);
+		mDroppedTime += mAccumulator - kept;
+		mAccumulator = kept;
+	}
+	return steps;
+}
+
+double KEngineCore::FixedTimestep::GetStepTime() const
+{
+	return mStepTime;
+}
+
+double KEngineCore::FixedTimestep::GetAlpha() const
+{
+	return mAccumulator / mStepTime;
+}
+
+double KEngineCore::FixedTimestep::GetDroppedTime() const
+{
+	return mDroppedTime;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+namespace KEngineCore {
+
+class Timer;
+
+///Turns the host's variable frame time into a whole number of fixed steps.  Real time is accumulated, and each Update
+///runs as many fixed steps as fit, stepping every registered updater and timer in the order they were added.
+///
+///Catch-up is capped: past maxStepsPerFrame the leftover time is dropped instead of carried, so one slow frame
+///can't snowball.  GetAlpha gives how far the accumulator is into the next step, for interpolating the render side.
+class FixedTimestep
+{
+public:
+	typedef void (*StepFunction)(void * object, double stepTime);
+	typedef bool (*EmptyFunction)(void * object);
+
+	FixedTimestep();
+	~FixedTimestep();
+
+	void Init(double stepTime, unsigned int maxStepsPerFrame = 8);
+	void Deinit();
+
+	///Anything with Update(double) and GetCount(), which is checked so that empty updaters cost next to nothing
+	template <class TUpdater>
+	void Add(TUpdater * updater);
+	void Add(Timer * timer);
+	///isEmpty may be null for objects that always need stepping
+	void Add(void * object, StepFunction step, EmptyFunction isEmpty = nullptr);
+	void Remove(void * object);
+
+	///Returns the number of fixed steps run
+	unsigned int Update(double elapsed);
+
+	double GetStepTime() const;
+	///Fraction of a step left in the accumulator, from 0 up to (not including) 1
+	double GetAlpha() const;
+	///Time thrown away by the catch-up cap since Init
+	double GetDroppedTime() const;
+
+private:
+	struct Stepper {
+		void *			mObject;
+		StepFunction	mStep;
+		EmptyFunction	mIsEmpty;
+	};
+
+	template <class TUpdater>
+	static void StepUpdater(void * object, double stepTime);
+	template <class TUpdater>
+	static bool IsUpdaterEmpty(void * object);
+
+	std::vector<Stepper>	mSteppers;
+	double					mStepTime {1.0 / 60.0};
+	double					mAccumulator {0.0};
+	double					mDroppedTime {0.0};
+	unsigned int			mMaxStepsPerFrame {8};
+};
+
+template <class TUpdater>
+void FixedTimestep::Add(TUpdater * updater)
+{
+	Add(updater, &StepUpdater<TUpdater>, &IsUpdaterEmpty<TUpdater>);
+}
+
+template <class TUpdater>
+void FixedTimestep::StepUpdater(void * object, double stepTime)
+{
+	((TUpdater *)object)->Update(stepTime);
+}
+
+template <class TUpdater>
+bool FixedTimestep::IsUpdaterEmpty(void * object)
+{
+	return ((TUpdater *)object)->GetCount() == 0;
+}
+
+}
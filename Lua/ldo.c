@@ -579,6 +579,15 @@ LUA_API int lua_yieldk (lua_State *L, int nresults, int ctx, lua_CFunction k) {
 }
 
 
+/*
+** KEngineCore: backported from Lua 5.3 so that a count hook can tell
+** whether forcing a yield is allowed at the current point
+*/
+LUA_API int lua_isyieldable (lua_State *L) {
+  return (L->nny == 0);
+}
+
+
 int luaD_pcall (lua_State *L, Pfunc func, void *u,
                 ptrdiff_t old_top, ptrdiff_t ef) {
   int status;
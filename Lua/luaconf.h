@@ -540,6 +540,16 @@
 ** without modifying the main part of the file.
 */
 
+/*
+** KEngineCore: reserve a pointer in front of every lua_State so that the
+** scheduler can map a thread back to its ScheduledLuaThread in constant
+** time.  The main state and every new thread start out with it cleared.
+*/
+#define LUAI_EXTRASPACE		sizeof(void *)
+#define lua_getextraspace(L)	((void *)((char *)(L) - LUAI_EXTRASPACE))
+#define luai_userstateopen(L)	(*(void **)lua_getextraspace(L) = NULL)
+#define luai_userstatethread(L,L1)	(*(void **)lua_getextraspace(L1) = NULL)
+
 
 
 #endif
@@ -0,0 +1,240 @@
+#include "LuaChunkCache.h"
+#include "Lua/lua.hpp"
+#include "StringHash.h"
+#include "Crc32.h"
+#include "TextFile.h"
+#include "PackArchive.h"
+#include <filesystem>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+
+KEngineCore::LuaChunkCache::LuaChunkCache()
+{
+}
+
+KEngineCore::LuaChunkCache::~LuaChunkCache()
+{
+	Deinit();
+}
+
+void KEngineCore::LuaChunkCache::Init(char const * persistDirectory, size_t maxSourceSize)
+{
+	mPersistDirectory = persistDirectory != nullptr ? persistDirectory : "";
+	mMaxSourceSize = maxSourceSize;
+	if (!mPersistDirectory.empty()) {
+		std::error_code error;
+		std::filesystem::create_directories(mPersistDirectory, error);
+	}
+}
+
+void KEngineCore::LuaChunkCache::Deinit()
+{
+	Clear();
+	mPersistDirectory.clear();
+}
+
+static int writeBytecode(lua_State *, const void * data, size_t size, void * userData) {
+	std::string * bytecode = (std::string *)userData;
+	bytecode->append((char const *)data, size);
+	return 0;
+}
+
+//Sources are handed to the parser this much at a time, so compiling a huge generated script never needs it all in memory at once
+static const size_t kSourceChunkSize = 16 * 1024;
+
+struct SourceFileReader {
+	FILE *	mFile;
+	char	mBuffer[kSourceChunkSize];
+};
+
+static const char * readSourceFile(lua_State *, void * userData, size_t * size) {
+	SourceFileReader * reader = (SourceFileReader *)userData;
+	*size = fread(reader->mBuffer, 1, sizeof(reader->mBuffer), reader->mFile);
+	return *size > 0 ? reader->mBuffer : nullptr;
+}
+
+struct SourceRegionReader {
+	const char *	mNext;
+	size_t			mRemaining;
+};
+
+static const char * readSourceRegion(lua_State *, void * userData, size_t * size) {
+	SourceRegionReader * reader = (SourceRegionReader *)userData;
+	*size = std::min(reader->mRemaining, kSourceChunkSize);
+	const char * chunk = reader->mNext;
+	reader->mNext += *size;
+	reader->mRemaining -= *size;
+	return *size > 0 ? chunk : nullptr;
+}
+
+int KEngineCore::LuaChunkCache::Load(lua_State * luaState, char const * scriptPath)
+{
+	std::string fileName = std::string(scriptPath) + ".lua";
+	PackArchiveFile packed = PackArchive::FindMounted(fileName);
+	Entry entry;
+	entry.mStamp = GetSourceStamp(fileName, packed);
+	entry.mPacked = (bool)packed;
+
+	auto found = mEntries.find(scriptPath);
+	if (found != mEntries.end() && found->second.mStamp == entry.mStamp && found->second.mPacked == entry.mPacked) {
+		mStats.mHits++;
+		return luaL_loadbuffer(luaState, found->second.mBytecode.data(), found->second.mBytecode.size(), scriptPath);
+	}
+
+	if (LoadPersisted(scriptPath, entry)) {
+		int result = luaL_loadbuffer(luaState, entry.mBytecode.data(), entry.mBytecode.size(), scriptPath);
+		if (result == LUA_OK) {
+			mStats.mDiskHits++;
+			mEntries[scriptPath] = std::move(entry);
+			return result;
+		}
+		lua_pop(luaState, 1);  //Stale or foreign dump (different Lua build, say); fall back to the source
+		entry.mBytecode.clear();
+	}
+
+	mStats.mMisses++;
+	bool cacheable = false;
+	int result = LoadSource(luaState, scriptPath, fileName, packed, cacheable);
+	if (result == LUA_OK && !cacheable) {
+		mStats.mUncached++;
+	} else if (result == LUA_OK && lua_dump(luaState, writeBytecode, &entry.mBytecode) == 0) {
+		Persist(scriptPath, entry);
+		mEntries[scriptPath] = std::move(entry);
+	}
+	return result;
+}
+
+//Streams the source through a lua_Reader: straight out of the mapping for packed scripts, in fixed size reads for loose
+//ones.  cacheable is set if the source is small enough to be worth dumping and keeping.
+int KEngineCore::LuaChunkCache::LoadSource(lua_State * luaState, char const * scriptPath, std::string const & fileName, PackArchiveFile const & packed, bool & cacheable) const
+{
+	if (packed) {
+		cacheable = packed.GetSize() <= mMaxSourceSize;
+		SourceRegionReader reader = {packed.GetData(), packed.GetSize()};
+		return lua_load(luaState, readSourceRegion, &reader, scriptPath, nullptr);
+	}
+
+	FILE * file = fopen(fileName.c_str(), "rb");
+	if (file == nullptr) {
+#if defined(__APPLE__)
+		//Not a plain file, so perhaps a bundle resource, which only TextFile knows how to find.  Those are small scripts
+		//shipped with the app, so they're read whole.
+		TextFile textFile;
+		if (textFile.TryLoadFromFile(scriptPath, ".lua")) {
+			std::string const & source = textFile.GetContents();
+			cacheable = source.length() <= mMaxSourceSize;
+			return luaL_loadbuffer(luaState, source.data(), source.length(), scriptPath);
+		}
+#endif
+		lua_pushfstring(luaState, "cannot open %s", fileName.c_str());
+		return LUA_ERRFILE;
+	}
+	std::error_code error;
+	uintmax_t size = std::filesystem::file_size(fileName, error);
+	cacheable = !error && size <= mMaxSourceSize;
+	std::unique_ptr<SourceFileReader> reader(new SourceFileReader);
+	reader->mFile = file;
+	int result = lua_load(luaState, readSourceFile, reader.get(), scriptPath, nullptr);
+	bool failed = ferror(file) != 0;
+	fclose(file);
+	if (failed) {
+		//A failed read looks like the end of the file to the parser, so whatever it made of the rest can't be trusted
+		lua_pop(luaState, 1);
+		lua_pushfstring(luaState, "cannot read %s", fileName.c_str());
+		return LUA_ERRFILE;
+	}
+	return result;
+}
+
+void KEngineCore::LuaChunkCache::Invalidate(char const * scriptPath)
+{
+	mEntries.erase(scriptPath);
+}
+
+void KEngineCore::LuaChunkCache::Clear()
+{
+	mEntries.clear();
+}
+
+KEngineCore::LuaChunkCacheStats const & KEngineCore::LuaChunkCache::GetStats() const
+{
+	return mStats;
+}
+
+void KEngineCore::LuaChunkCache::ResetStats()
+{
+	mStats = LuaChunkCacheStats();
+}
+
+long long KEngineCore::LuaChunkCache::GetSourceStamp(std::string const & fileName, PackArchiveFile const & packed) const
+{
+	if (packed) {
+		//The archive's contents, not the loose file's time, since that's what gets compiled.  Sources too big to cache
+		//aren't worth hashing.
+		if (packed.GetSize() > mMaxSourceSize) {
+			return 0;
+		}
+		return (long long)packed.GetSize() << 32 | Crc32Fast(packed.GetData(), packed.GetSize());
+	}
+	//Sources that can't be stat'ed (bundle resources, say) get a stamp of zero and are never revalidated
+	std::error_code error;
+	auto writeTime = std::filesystem::last_write_time(fileName, error);
+	if (error) {
+		return 0;
+	}
+	return (long long)writeTime.time_since_epoch().count();
+}
+
+std::string KEngineCore::LuaChunkCache::GetPersistPath(char const * scriptPath) const
+{
+	char name[16];
+	snprintf(name, sizeof(name), "%08x", (unsigned int)StringHash(scriptPath));
+	return mPersistDirectory + "/" + name + ".luac";
+}
+
+//Persisted chunks are the stamp, whether it's a packed one, the length of the script path, the script path and then the
+//lua_dump output
+bool KEngineCore::LuaChunkCache::LoadPersisted(char const * scriptPath, Entry & entry) const
+{
+	if (mPersistDirectory.empty()) {
+		return false;
+	}
+	std::ifstream file(GetPersistPath(scriptPath), std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	long long persistedStamp = 0;
+	char persistedPacked = 0;
+	unsigned int pathLength = 0;
+	file.read((char *)&persistedStamp, sizeof(persistedStamp));
+	file.read(&persistedPacked, sizeof(persistedPacked));
+	file.read((char *)&pathLength, sizeof(pathLength));
+	if (!file || persistedStamp != entry.mStamp || entry.mStamp == 0 || persistedPacked != (char)entry.mPacked || pathLength != strlen(scriptPath)) {
+		return false;  //A different script's dump, or a truncated or corrupt file; either way the length can't be trusted
+	}
+	std::string persistedPath(pathLength, '\0');
+	file.read(&persistedPath[0], pathLength);
+	if (!file || persistedPath != scriptPath) {
+		return false;  //Hash collision with another script
+	}
+	entry.mBytecode.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return !entry.mBytecode.empty();
+}
+
+void KEngineCore::LuaChunkCache::Persist(char const * scriptPath, Entry const & entry) const
+{
+	if (mPersistDirectory.empty() || entry.mStamp == 0) {
+		return;
+	}
+	std::ofstream file(GetPersistPath(scriptPath), std::ios::binary | std::ios::trunc);
+	unsigned int pathLength = (unsigned int)strlen(scriptPath);
+	char packed = (char)entry.mPacked;
+	file.write((char const *)&entry.mStamp, sizeof(entry.mStamp));
+	file.write(&packed, sizeof(packed));
+	file.write((char const *)&pathLength, sizeof(pathLength));
+	file.write(scriptPath, pathLength);
+	file.write(entry.mBytecode.data(), entry.mBytecode.size());
+}
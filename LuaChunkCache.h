@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+struct lua_State;
+
+namespace KEngineCore {
+
+class PackArchiveFile;
+
+struct LuaChunkCacheStats {
+	size_t mHits {0};		///Served from memory
+	size_t mDiskHits {0};	///Served from a persisted dump
+	size_t mMisses {0};		///Compiled from source
+	size_t mUncached {0};	///Compiled from source and not kept, being over the size limit
+};
+
+///Caches compiled scripts by path and source modification stamp, so spawning the same script again
+///skips lexing and parsing.  Optionally persists the compiled chunks so the next run can skip them too.
+///
+///Loose scripts are stamped with their write time, and scripts served from a mounted PackArchive with a CRC of their
+///packed bytes, so mounting a patch archive or unmounting one is noticed like an edit would be.
+class LuaChunkCache
+{
+public:
+	LuaChunkCache();
+	~LuaChunkCache();
+
+	static constexpr size_t kDefaultMaxSourceSize = 1024 * 1024;
+
+	///persistDirectory may be null to keep the cache in memory only.  Scripts bigger than maxSourceSize (huge generated
+	///data scripts, typically) are streamed into the parser on every load and never dumped or cached, so loading them
+	///costs only what the parser holds.
+	void Init(char const * persistDirectory = nullptr, size_t maxSourceSize = kDefaultMaxSourceSize);
+	void Deinit();
+
+	///Pushes the compiled chunk for scriptPath (".lua" is appended, as with TextFile), or an error message.  Returns the
+	///lua_load status, which is LUA_ERRFILE for a missing or unreadable script.
+	int Load(lua_State * luaState, char const * scriptPath);
+
+	void Invalidate(char const * scriptPath);
+	void Clear();
+
+	LuaChunkCacheStats const & GetStats() const;
+	void ResetStats();
+
+private:
+	struct Entry {
+		long long	mStamp {0};
+		bool		mPacked {false};	///mStamp is from the archive entry rather than the file on disk
+		std::string	mBytecode;
+	};
+
+	int LoadSource(lua_State * luaState, char const * scriptPath, std::string const & fileName, PackArchiveFile const & packed, bool & cacheable) const;
+	long long GetSourceStamp(std::string const & fileName, PackArchiveFile const & packed) const;
+	std::string GetPersistPath(char const * scriptPath) const;
+	bool LoadPersisted(char const * scriptPath, Entry & entry) const;
+	void Persist(char const * scriptPath, Entry const & entry) const;
+
+	std::unordered_map<std::string, Entry>	mEntries;
+	std::string								mPersistDirectory;
+	size_t									mMaxSourceSize {kDefaultMaxSourceSize};
+	LuaChunkCacheStats						mStats;
+};
+
+}
@@ -0,0 +1,332 @@
+#include "LuaGarbageCollector.h"
+#include "Lua/lua.hpp"
+#include <assert.h>
+#include <chrono>
+#include <cstdint>
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+KEngineCore::LuaGarbageCollector::LuaGarbageCollector()
+{
+}
+
+KEngineCore::LuaGarbageCollector::~LuaGarbageCollector()
+{
+	Deinit();
+}
+
+void KEngineCore::LuaGarbageCollector::Init(lua_State * mainState)
+{
+	assert(mMainState == nullptr);
+	mMainState = mainState;
+	lua_gc(mMainState, LUA_GCSTOP, 0);
+	lua_gc(mMainState, LUA_GCSETPAUSE, mPause);
+	lua_gc(mMainState, LUA_GCSETSTEPMUL, mStepMultiplier);
+	mNextCycleStart = 0;  //Start collecting straight away
+	mSurvived = 0;
+	mCycleRunning = false;
+	RegisterLibrary(mMainState);
+}
+
+void KEngineCore::LuaGarbageCollector::Deinit()
+{
+	if (mMainState != nullptr) {
+		lua_gc(mMainState, LUA_GCRESTART, 0);
+		mMainState = nullptr;
+	}
+}
+
+void KEngineCore::LuaGarbageCollector::Step(double maxTime)
+{
+	assert(mMainState != nullptr);
+	double budget = maxTime < mStepBudget ? maxTime : mStepBudget;
+	if (budget < mMinimumStep) {
+		budget = mMinimumStep;  //Otherwise a frame loop that's always busy would never collect at all
+	}
+	if (budget <= 0.0) {
+		return;
+	}
+	if (!mCycleRunning) {
+		if (GetMemoryUse() < mNextCycleStart) {
+			return;
+		}
+		mCycleRunning = true;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	double longestStep = 0.0;
+	while (true) {
+		auto stepStart = std::chrono::steady_clock::now();
+		int cycleFinished = lua_gc(mMainState, LUA_GCSTEP, mStepSize);
+		double pause = secondsSince(stepStart);
+		RecordPause(pause);
+		if (pause > longestStep) {
+			longestStep = pause;
+		}
+
+		//A generational step is a whole minor collection, so it counts as a cycle of its own
+		if (cycleFinished || mMode == LuaGCMode::Generational) {
+			EndCycle();
+			break;  //The next cycle waits for the heap to grow again
+		}
+		//Stop if another step as long as the longest so far would overrun
+		if (secondsSince(start) + longestStep > budget) {
+			break;
+		}
+	}
+}
+
+bool KEngineCore::LuaGarbageCollector::CheckEmergency()
+{
+	size_t threshold = mEmergencyThreshold;
+	if (threshold == 0) {
+		threshold = mSurvived * kAutomaticEmergencyMultiple;
+		if (threshold < kMinimumAutomaticEmergency) {
+			threshold = kMinimumAutomaticEmergency;
+		}
+	}
+	if (GetMemoryUse() < threshold) {
+		return false;
+	}
+	mStats.mEmergencyCollections++;
+	Collect();
+	return true;
+}
+
+void KEngineCore::LuaGarbageCollector::Collect()
+{
+	assert(mMainState != nullptr);
+	auto start = std::chrono::steady_clock::now();
+	lua_gc(mMainState, LUA_GCCOLLECT, 0);
+	RecordPause(secondsSince(start));
+	EndCycle();
+}
+
+void KEngineCore::LuaGarbageCollector::SetStepBudget(double seconds)
+{
+	mStepBudget = seconds;
+}
+
+double KEngineCore::LuaGarbageCollector::GetStepBudget() const
+{
+	return mStepBudget;
+}
+
+void KEngineCore::LuaGarbageCollector::SetMinimumStep(double seconds)
+{
+	mMinimumStep = seconds;
+}
+
+double KEngineCore::LuaGarbageCollector::GetMinimumStep() const
+{
+	return mMinimumStep;
+}
+
+void KEngineCore::LuaGarbageCollector::SetStepSize(int kilobytes)
+{
+	mStepSize = kilobytes;
+}
+
+void KEngineCore::LuaGarbageCollector::SetEmergencyThreshold(size_t bytes)
+{
+	mEmergencyThreshold = bytes;
+}
+
+size_t KEngineCore::LuaGarbageCollector::GetEmergencyThreshold() const
+{
+	return mEmergencyThreshold;
+}
+
+void KEngineCore::LuaGarbageCollector::SetMode(LuaGCMode mode)
+{
+	assert(mMainState != nullptr);
+	if (mode == mMode) {
+		return;
+	}
+	mMode = mode;
+	//Changing mode finishes any cycle in progress (and may start the collector up again), so it's a cycle boundary for us too
+	auto start = std::chrono::steady_clock::now();
+	lua_gc(mMainState, mode == LuaGCMode::Generational ? LUA_GCGEN : LUA_GCINC, 0);
+	lua_gc(mMainState, LUA_GCSTOP, 0);
+	RecordPause(secondsSince(start));
+	EndCycle();
+}
+
+KEngineCore::LuaGCMode KEngineCore::LuaGarbageCollector::GetMode() const
+{
+	return mMode;
+}
+
+int KEngineCore::LuaGarbageCollector::SetPause(int pause)
+{
+	int previous = mPause;
+	mPause = pause;
+	if (mMainState != nullptr) {
+		lua_gc(mMainState, LUA_GCSETPAUSE, pause);
+	}
+	return previous;
+}
+
+int KEngineCore::LuaGarbageCollector::SetStepMultiplier(int stepMultiplier)
+{
+	int previous = mStepMultiplier;
+	mStepMultiplier = stepMultiplier;
+	if (mMainState != nullptr) {
+		lua_gc(mMainState, LUA_GCSETSTEPMUL, stepMultiplier);
+	}
+	return previous;
+}
+
+size_t KEngineCore::LuaGarbageCollector::GetMemoryUse() const
+{
+	assert(mMainState != nullptr);
+	return ((size_t)lua_gc(mMainState, LUA_GCCOUNT, 0) << 10) + lua_gc(mMainState, LUA_GCCOUNTB, 0);
+}
+
+KEngineCore::LuaGCStats const & KEngineCore::LuaGarbageCollector::GetStats() const
+{
+	return mStats;
+}
+
+void KEngineCore::LuaGarbageCollector::ResetStats()
+{
+	mStats = LuaGCStats();
+}
+
+void KEngineCore::LuaGarbageCollector::RecordPause(double pause)
+{
+	LuaGCCycleStats & cycle = mStats.mCurrentCycle;
+	mStats.mSteps++;
+	cycle.mSteps++;
+	cycle.mTime += pause;
+	if (pause > cycle.mLongestPause) {
+		cycle.mLongestPause = pause;
+	}
+	int bucket = 0;
+	for (double limit = 2e-6; pause >= limit && bucket < LuaGCCycleStats::kPauseBuckets - 1; limit *= 2.0) {
+		bucket++;
+	}
+	cycle.mPauseHistogram[bucket]++;
+}
+
+void KEngineCore::LuaGarbageCollector::EndCycle()
+{
+	mStats.mCycles++;
+	mStats.mLastCycle = mStats.mCurrentCycle;
+	mStats.mCurrentCycle = LuaGCCycleStats();
+	mCycleRunning = false;
+	//Same pacing the collector would use on its own: wait for the heap to grow by pause percent of what survived
+	mSurvived = GetMemoryUse();
+	mNextCycleStart = mSurvived / 100 * mPause;
+}
+
+static KEngineCore::LuaGarbageCollector * getCollector(lua_State * luaState) {
+	return (KEngineCore::LuaGarbageCollector *)lua_touserdata(luaState, lua_upvalueindex(1));
+}
+
+static void pushCycleStats(lua_State * luaState, KEngineCore::LuaGCCycleStats const & cycle) {
+	lua_checkstack(luaState, 3);
+	lua_createtable(luaState, 0, 4);
+	lua_pushinteger(luaState, cycle.mSteps);
+	lua_setfield(luaState, -2, "steps");
+	lua_pushnumber(luaState, cycle.mTime);
+	lua_setfield(luaState, -2, "time");
+	lua_pushnumber(luaState, cycle.mLongestPause);
+	lua_setfield(luaState, -2, "longest");
+	lua_createtable(luaState, KEngineCore::LuaGCCycleStats::kPauseBuckets, 0);
+	for (int bucket = 0; bucket < KEngineCore::LuaGCCycleStats::kPauseBuckets; bucket++) {
+		lua_pushinteger(luaState, cycle.mPauseHistogram[bucket]);
+		lua_rawseti(luaState, -2, bucket + 1);
+	}
+	lua_setfield(luaState, -2, "histogram");
+}
+
+static int mode(lua_State * luaState) {
+	static char const * const modeNames[] = {"incremental", "generational", nullptr};
+	KEngineCore::LuaGarbageCollector * collector = getCollector(luaState);
+	lua_pushstring(luaState, modeNames[(int)collector->GetMode()]);
+	if (!lua_isnone(luaState, 1)) {
+		collector->SetMode((KEngineCore::LuaGCMode)luaL_checkoption(luaState, 1, nullptr, modeNames));
+	}
+	return 1;
+}
+
+static int pause(lua_State * luaState) {
+	lua_pushinteger(luaState, getCollector(luaState)->SetPause(luaL_checkint(luaState, 1)));
+	return 1;
+}
+
+static int stepmul(lua_State * luaState) {
+	lua_pushinteger(luaState, getCollector(luaState)->SetStepMultiplier(luaL_checkint(luaState, 1)));
+	return 1;
+}
+
+static int budget(lua_State * luaState) {
+	KEngineCore::LuaGarbageCollector * collector = getCollector(luaState);
+	lua_pushnumber(luaState, collector->GetStepBudget());
+	if (!lua_isnone(luaState, 1)) {
+		collector->SetStepBudget(luaL_checknumber(luaState, 1));
+	}
+	return 1;
+}
+
+static int threshold(lua_State * luaState) {
+	KEngineCore::LuaGarbageCollector * collector = getCollector(luaState);
+	lua_pushnumber(luaState, (lua_Number)collector->GetEmergencyThreshold());
+	if (!lua_isnone(luaState, 1)) {
+		lua_Number bytes = luaL_checknumber(luaState, 1);
+		collector->SetEmergencyThreshold(bytes >= (lua_Number)SIZE_MAX ? SIZE_MAX : (size_t)bytes);  //math.huge turns it off
+	}
+	return 1;
+}
+
+static int collect(lua_State * luaState) {
+	getCollector(luaState)->Collect();
+	return 0;
+}
+
+static int stats(lua_State * luaState) {
+	KEngineCore::LuaGarbageCollector * collector = getCollector(luaState);
+	KEngineCore::LuaGCStats const & gcStats = collector->GetStats();
+	lua_checkstack(luaState, 2);
+	lua_createtable(luaState, 0, 6);
+	lua_pushnumber(luaState, (lua_Number)collector->GetMemoryUse());
+	lua_setfield(luaState, -2, "memory");
+	lua_pushinteger(luaState, gcStats.mSteps);
+	lua_setfield(luaState, -2, "steps");
+	lua_pushinteger(luaState, gcStats.mCycles);
+	lua_setfield(luaState, -2, "cycles");
+	lua_pushinteger(luaState, gcStats.mEmergencyCollections);
+	lua_setfield(luaState, -2, "emergencies");
+	pushCycleStats(luaState, gcStats.mCurrentCycle);
+	lua_setfield(luaState, -2, "currentCycle");
+	pushCycleStats(luaState, gcStats.mLastCycle);
+	lua_setfield(luaState, -2, "lastCycle");
+	return 1;
+}
+
+static const struct luaL_Reg gcLibrary [] = {
+	{"mode", mode},
+	{"pause", pause},
+	{"stepmul", stepmul},
+	{"budget", budget},
+	{"threshold", threshold},
+	{"collect", collect},
+	{"stats", stats},
+	{nullptr, nullptr}
+};
+
+static int luaopen_gc (lua_State * luaState) {
+	lua_checkstack(luaState, 2);
+	luaL_newlibtable(luaState, gcLibrary);
+	lua_pushvalue(luaState, lua_upvalueindex(1));
+	luaL_setfuncs(luaState, gcLibrary, 1);
+
+	return 1;
+};
+
+void KEngineCore::LuaGarbageCollector::RegisterLibrary(lua_State * luaState, char const * name) {
+	PreloadLibrary(luaState, name, luaopen_gc);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "LuaLibrary.h"
+#include <cstddef>
+
+struct lua_State;
+
+namespace KEngineCore {
+
+enum class LuaGCMode {
+	Incremental,
+	Generational
+};
+
+struct LuaGCCycleStats {
+	static constexpr int kPauseBuckets = 16;
+
+	size_t	mSteps {0};
+	double	mTime {0.0};			///Total time spent collecting, in seconds
+	double	mLongestPause {0.0};
+	size_t	mPauseHistogram[kPauseBuckets] {};	///Bucket i counts pauses under 2^(i+1) microseconds; the last takes everything longer
+};
+
+struct LuaGCStats {
+	size_t	mSteps {0};
+	size_t	mCycles {0};
+	size_t	mEmergencyCollections {0};
+	LuaGCCycleStats	mCurrentCycle;
+	LuaGCCycleStats	mLastCycle;
+};
+
+///Takes garbage collection away from the allocator's debt and hands it to the frame.  Once initialized the collector
+///never runs on its own (so never in the middle of a resume); instead Step does incremental work in whatever time the
+///frame has left, and CheckEmergency does a full collection if memory gets past a threshold regardless.
+///
+///LuaScheduler drives both when given one with SetGarbageCollector.
+class LuaGarbageCollector : protected LuaLibrary
+{
+public:
+	static constexpr size_t kAutomaticEmergencyMultiple = 4;
+	static constexpr size_t kMinimumAutomaticEmergency = 16 * 1024 * 1024;
+
+	LuaGarbageCollector();
+	~LuaGarbageCollector();
+
+	void Init(lua_State * mainState);
+	void Deinit();
+
+	virtual void RegisterLibrary(lua_State * luaState, char const * name = "gc") override;
+
+	///Collects for up to the smaller of maxTime and the step budget, in seconds, but never less than the minimum step, so
+	///a frame whose threads used all its time still makes some progress.  Does nothing while the heap is still below
+	///where the pause setting says the next cycle should start.
+	void Step(double maxTime);
+	///Collects everything now if memory is over the emergency threshold; returns whether it did
+	bool CheckEmergency();
+	void Collect();
+
+	void SetStepBudget(double seconds);
+	double GetStepBudget() const;
+	///0 lets a frame with no time left skip collecting entirely, leaving it to the emergency threshold
+	void SetMinimumStep(double seconds);
+	double GetMinimumStep() const;
+	///Kilobytes of allocation each LUA_GCSTEP pays off; smaller steps mean finer-grained pauses
+	void SetStepSize(int kilobytes);
+	///0, the default, sets it from the heap: kAutomaticEmergencyMultiple times what survived the last cycle, and no less
+	///than kMinimumAutomaticEmergency.  SIZE_MAX turns the emergency collection off.
+	void SetEmergencyThreshold(size_t bytes);
+	size_t GetEmergencyThreshold() const;
+
+	void SetMode(LuaGCMode mode);
+	LuaGCMode GetMode() const;
+	///Both return the previous value, as lua_gc does, and may be set before Init
+	int SetPause(int pause);
+	int SetStepMultiplier(int stepMultiplier);
+
+	size_t GetMemoryUse() const;
+	LuaGCStats const & GetStats() const;
+	void ResetStats();
+
+private:
+	void RecordPause(double pause);
+	void EndCycle();
+
+	lua_State *		mMainState {nullptr};
+	LuaGCMode		mMode {LuaGCMode::Incremental};
+	double			mStepBudget {0.001};
+	double			mMinimumStep {0.0001};
+	int				mStepSize {0};
+	int				mPause {200};			///Lua's defaults
+	int				mStepMultiplier {200};
+	size_t			mEmergencyThreshold {0};
+	size_t			mNextCycleStart {0};	///Heap size the next cycle waits for, per the pause setting
+	size_t			mSurvived {0};			///Heap size the last cycle left
+	bool			mCycleRunning {false};
+	LuaGCStats		mStats;
+};
+
+}
@@ -0,0 +1,146 @@
+#include "LuaPoolAllocator.h"
+#include <assert.h>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+KEngineCore::LuaPoolAllocator::LuaPoolAllocator()
+{
+	for (size_t classIndex = 0; classIndex < LuaAllocatorStats::kClassCount; classIndex++) {
+		mStats.mClasses[classIndex].mBlockSize = (classIndex + 1) * kGranularity;
+	}
+}
+
+KEngineCore::LuaPoolAllocator::~LuaPoolAllocator()
+{
+	for (auto it = mPages.begin(); it != mPages.end(); it++) {
+		free(*it);
+	}
+	mPages.clear();
+}
+
+void * KEngineCore::LuaPoolAllocator::Alloc(void * userData, void * block, size_t oldSize, size_t newSize)
+{
+	LuaPoolAllocator * allocator = (LuaPoolAllocator *)userData;
+	if (block == nullptr) {
+		//oldSize is the type of object being created here, not a size
+		return newSize == 0 ? nullptr : allocator->Allocate(newSize);
+	}
+	if (newSize == 0) {
+		allocator->Free(block, oldSize);
+		return nullptr;
+	}
+	return allocator->Reallocate(block, oldSize, newSize);
+}
+
+void * KEngineCore::LuaPoolAllocator::Allocate(size_t size)
+{
+	if (size > kMaxPooledSize) {
+		void * block = malloc(size);
+		if (block != nullptr) {
+			mStats.mLargeAllocations++;
+			mStats.mLargeLiveBytes += size;
+		}
+		return block;
+	}
+	return AllocateFromClass(GetClassIndex(size));
+}
+
+void KEngineCore::LuaPoolAllocator::Free(void * block, size_t size)
+{
+	if (block == nullptr) {
+		return;
+	}
+	if (size > kMaxPooledSize) {
+		mStats.mLargeFrees++;
+		mStats.mLargeLiveBytes -= size;
+		free(block);
+		return;
+	}
+	FreeToClass(block, GetClassIndex(size));
+}
+
+void * KEngineCore::LuaPoolAllocator::Reallocate(void * block, size_t oldSize, size_t newSize)
+{
+	if (oldSize > kMaxPooledSize && newSize > kMaxPooledSize) {
+		void * grown = realloc(block, newSize);
+		if (grown != nullptr) {
+			mStats.mLargeLiveBytes += newSize - oldSize;
+		}
+		return grown;
+	}
+	if (oldSize <= kMaxPooledSize && newSize <= kMaxPooledSize && GetClassIndex(oldSize) == GetClassIndex(newSize)) {
+		return block;  //Still fits its block
+	}
+
+	void * moved = Allocate(newSize);
+	if (moved == nullptr) {
+		return nullptr;  //Lua keeps the old block when a reallocation fails
+	}
+	memcpy(moved, block, std::min(oldSize, newSize));
+	Free(block, oldSize);
+	return moved;
+}
+
+KEngineCore::LuaAllocatorStats const & KEngineCore::LuaPoolAllocator::GetStats() const
+{
+	return mStats;
+}
+
+void KEngineCore::LuaPoolAllocator::ResetStats()
+{
+	for (size_t classIndex = 0; classIndex < LuaAllocatorStats::kClassCount; classIndex++) {
+		LuaAllocatorClassStats & classStats = mStats.mClasses[classIndex];
+		classStats.mAllocations = 0;
+		classStats.mFrees = 0;
+		classStats.mPeakLive = classStats.mLive;
+	}
+	mStats.mLargeAllocations = 0;
+	mStats.mLargeFrees = 0;
+}
+
+size_t KEngineCore::LuaPoolAllocator::GetClassIndex(size_t size)
+{
+	assert(size > 0 && size <= kMaxPooledSize);
+	return (size - 1) / kGranularity;
+}
+
+void * KEngineCore::LuaPoolAllocator::AllocateFromClass(size_t classIndex)
+{
+	SizeClass & sizeClass = mClasses[classIndex];
+	LuaAllocatorClassStats & classStats = mStats.mClasses[classIndex];
+	void * block;
+	if (sizeClass.mFree != nullptr) {
+		block = sizeClass.mFree;
+		sizeClass.mFree = sizeClass.mFree->mNext;
+	} else {
+		if (sizeClass.mBump == sizeClass.mBumpEnd) {
+			//Pages are carved lazily, so a class that only ever holds a few blocks only touches a few cache lines
+			char * page = (char *)malloc(kPageSize);
+			if (page == nullptr) {
+				return nullptr;
+			}
+			mPages.push_back(page);
+			mStats.mPageBytes += kPageSize;
+			sizeClass.mBump = page;
+			sizeClass.mBumpEnd = page + (kPageSize / classStats.mBlockSize) * classStats.mBlockSize;
+		}
+		block = sizeClass.mBump;
+		sizeClass.mBump += classStats.mBlockSize;
+	}
+	classStats.mAllocations++;
+	classStats.mLive++;
+	classStats.mPeakLive = std::max(classStats.mPeakLive, classStats.mLive);
+	return block;
+}
+
+void KEngineCore::LuaPoolAllocator::FreeToClass(void * block, size_t classIndex)
+{
+	SizeClass & sizeClass = mClasses[classIndex];
+	LuaAllocatorClassStats & classStats = mStats.mClasses[classIndex];
+	FreeBlock * freeBlock = (FreeBlock *)block;
+	freeBlock->mNext = sizeClass.mFree;
+	sizeClass.mFree = freeBlock;
+	classStats.mFrees++;
+	classStats.mLive--;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+namespace KEngineCore {
+
+struct LuaAllocatorClassStats {
+	size_t	mBlockSize {0};
+	size_t	mAllocations {0};
+	size_t	mFrees {0};
+	size_t	mLive {0};
+	size_t	mPeakLive {0};
+};
+
+struct LuaAllocatorStats {
+	static constexpr size_t kClassCount = 32;
+
+	LuaAllocatorClassStats	mClasses[kClassCount];
+	size_t	mLargeAllocations {0};	///Blocks too big for a size class, passed through to malloc
+	size_t	mLargeFrees {0};
+	size_t	mLargeLiveBytes {0};
+	size_t	mPageBytes {0};		///Reserved for the size classes, live or free
+};
+
+///lua_Alloc that serves the small, fixed-size allocations Lua makes most of (strings, tables, closures, call infos,
+///upvalues) from per-size-class free lists carved out of larger pages, and passes anything bigger through to malloc.
+///
+///An allocator isn't thread-safe; it's meant to belong to one lua_State (and so one thread at a time), which is what
+///keeps it lock-free.  It must outlive the state, and frees all of its pages when destroyed.
+class LuaPoolAllocator
+{
+public:
+	static constexpr size_t kGranularity = 16;
+	static constexpr size_t kMaxPooledSize = kGranularity * LuaAllocatorStats::kClassCount;
+
+	LuaPoolAllocator();
+	~LuaPoolAllocator();
+
+	///Pass this with the allocator as the userdata to lua_newstate or LuaScheduler::Init
+	static void * Alloc(void * userData, void * block, size_t oldSize, size_t newSize);
+
+	void * Allocate(size_t size);
+	void Free(void * block, size_t size);
+	void * Reallocate(void * block, size_t oldSize, size_t newSize);
+
+	LuaAllocatorStats const & GetStats() const;
+	///Zeroes the counters, keeping the live and page figures
+	void ResetStats();
+
+private:
+	static constexpr size_t kPageSize = 16 * 1024;
+
+	struct FreeBlock {
+		FreeBlock *	mNext;
+	};
+
+	struct SizeClass {
+		FreeBlock *	mFree {nullptr};
+		char *		mBump {nullptr};	///Unused tail of the class's newest page
+		char *		mBumpEnd {nullptr};
+	};
+
+	static size_t GetClassIndex(size_t size);
+	void * AllocateFromClass(size_t classIndex);
+	void FreeToClass(void * block, size_t classIndex);
+
+	SizeClass					mClasses[LuaAllocatorStats::kClassCount];
+	std::vector<void *>			mPages;
+	LuaAllocatorStats			mStats;
+};
+
+}
@@ -1,8 +1,10 @@
 #include "LuaScheduler.h"
 #include "Lua/lua.hpp"
-#include "TextFile.h"
+#include "LuaGarbageCollector.h"
 #include <assert.h>
 #include <vector>
+#include <algorithm>
+#include <chrono>
 
 
 KEngineCore::LuaScheduler::LuaScheduler(void)
@@ -16,23 +18,44 @@ KEngineCore::LuaScheduler::~LuaScheduler(void)
 	Deinit();
 }
 
-void KEngineCore::LuaScheduler::Init() {
+static int panic(lua_State * luaState) {
+	fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", lua_tostring(luaState, -1));
+	return 0;
+}
+
+void KEngineCore::LuaScheduler::Init(lua_Alloc allocator, void * allocatorUserData) {
 	assert(!mMainState);
-	mMainState = luaL_newstate();
+	if (allocator != nullptr) {
+		mMainState = lua_newstate(allocator, allocatorUserData);
+		lua_atpanic(mMainState, panic);  //Same as luaL_newstate's
+	} else {
+		mMainState = luaL_newstate();
+	}
+#ifndef NDEBUG
+	//Count allocations so callers can check paths that shouldn't make any, like timer.waits
+	mAllocator = lua_getallocf(mMainState, &mAllocatorUserData);
+	mAllocations = 0;
+	lua_setallocf(mMainState, CountAllocation, this);
+#endif
 	luaL_openlibs(mMainState);
 	RegisterLibrary(mMainState);
 }
 
 void KEngineCore::LuaScheduler::Deinit() {
-	mRunningThreads.clear();
-	std::vector<ScheduledLuaThread *> deadThreads;
-	for (auto iterator = mAllThreads.begin(); iterator != mAllThreads.end(); iterator++) {
-		deadThreads.push_back(iterator->second);
+	mRunningThreads.Clear();
+	while (!mAllThreads.empty()) {
+		KillThread(mAllThreads.back());
+	}
+	for (auto it = mPooledThreads.begin(); it != mPooledThreads.end(); it++) {
+		delete *it;
 	}
-	for (auto it = deadThreads.begin(); it != deadThreads.end(); it++) {
-		KillThread(*it);
+	mPooledThreads.clear();
+	mFreeThreads.clear();
+	mChunkCache.Clear();
+	if (mGarbageCollector != nullptr) {
+		mGarbageCollector->Deinit();  //It's bound to the state about to close
+		mGarbageCollector = nullptr;
 	}
-	mAllThreads.clear();
 	if (mMainState != nullptr) {
 		lua_close(mMainState);
 		mMainState = nullptr;
@@ -54,7 +77,10 @@ void KEngineCore::LuaScheduler::ScheduleThread(ScheduledLuaThread * thread, bool
 	if (running) {
 		mResumingThreads.push_back(thread);
 	}
-	mAllThreads[thread->mThreadState] = thread;
+	//Point the thread's extra space back at its ScheduledLuaThread for GetScheduledThread
+	*(ScheduledLuaThread **)lua_getextraspace(thread->mThreadState) = thread;
+	thread->mAllThreadsIndex = mAllThreads.size();
+	mAllThreads.push_back(thread);
 }
 
 
@@ -73,6 +99,16 @@ void KEngineCore::LuaScheduler::ResumeThread(ScheduledLuaThread * thread) {
 void KEngineCore::LuaScheduler::KillThread(ScheduledLuaThread * thread) {
 	assert(mMainState);
 	assert(thread->mScheduler == this);
+	if (thread->mAllThreadsIndex != SIZE_MAX) {
+		//Swap and pop.  The thread state is still anchored in the registry at this point, so its extra space is safe to clear.
+		ScheduledLuaThread * last = mAllThreads.back();
+		mAllThreads[thread->mAllThreadsIndex] = last;
+		last->mAllThreadsIndex = thread->mAllThreadsIndex;
+		mAllThreads.pop_back();
+		thread->mAllThreadsIndex = SIZE_MAX;
+		*(ScheduledLuaThread **)lua_getextraspace(thread->mThreadState) = nullptr;
+	}
+
 	lua_checkstack(mMainState, 2);
 	lua_pushlightuserdata(mMainState, thread);
 	lua_pushnil(mMainState);
@@ -82,41 +118,63 @@ void KEngineCore::LuaScheduler::KillThread(ScheduledLuaThread * thread) {
 	thread->SetRegistryIndex(LUA_REFNIL);
 	luaL_unref(mMainState, LUA_REGISTRYINDEX, threadRef);
 
-	if (thread->mPosition != mRunningThreads.end()) {
-		mRunningThreads.erase(thread->mPosition);
-		thread->mPosition = mRunningThreads.end();
+	thread->Unschedule(); //Stop any pending sleep
+	ForgetPending(thread);  //A pause or resume queued before it died mustn't put it back in the running set
+
+	if (mUpdating) {
+		ScheduledLuaThread ** running = mRunningThreads.Get(thread->mRunningHandle);
+		if (running != nullptr) {
+			*running = nullptr;  //Leave a hole so Update's iteration isn't disturbed
+			mKilledRunningThreads.push_back(thread->mRunningHandle);
+		}
+	} else {
+		mRunningThreads.Erase(thread->mRunningHandle);
 	}
-	mAllThreads.erase(thread->mThreadState);
+	thread->mRunningHandle = SlotMapHandle();
 }
 
-void KEngineCore::LuaScheduler::Update() {
-	std::vector<ScheduledLuaThread *> deadThreads;
-
+void KEngineCore::LuaScheduler::Update(double timeBudget) {
 	for (auto it = mPausingThreads.begin(); it != mPausingThreads.end(); it++)
 	{
 		ScheduledLuaThread *thread = *it;
-		mRunningThreads.erase(thread->mPosition);
-		thread->mPosition = mRunningThreads.end();
+		mRunningThreads.Erase(thread->mRunningHandle);
+		thread->mRunningHandle = SlotMapHandle();
 	}	
 	mPausingThreads.clear();
 
 	for (auto it = mResumingThreads.begin(); it != mResumingThreads.end(); it++)
 	{
 		ScheduledLuaThread *thread = *it;
-		mRunningThreads.push_front(*it);
-		thread->mPosition = mRunningThreads.begin();
+		if (!mRunningThreads.Contains(thread->mRunningHandle)) {
+			thread->mRunningHandle = mRunningThreads.Insert(thread);
+		}
 	}
 	mResumingThreads.clear();
 
-	for (auto it = mRunningThreads.begin(); it != mRunningThreads.end(); it++)
+	mUpdating = true;
+	mFrameStats = LuaSchedulerFrameStats();
+	auto start = std::chrono::steady_clock::now();
+	size_t runningCount = mRunningThreads.Size();
+	size_t first = runningCount > 0 ? mNextThread % runningCount : 0;
+	size_t visited = 0;
+	for (; visited < runningCount; visited++)
 	{
-		ScheduledLuaThread * thread = *it;
+		if (timeBudget > 0.0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= timeBudget) {
+			break;
+		}
+		ScheduledLuaThread * thread = mRunningThreads[(first + visited) % runningCount];
+		if (thread == nullptr) {
+			continue;  //Killed earlier in this pass
+		}
 		lua_State * threadState = thread->mThreadState;
+		if (mGarbageCollector != nullptr) {
+			mGarbageCollector->CheckEmergency();
+		}
 
-		int scriptResult = lua_resume(threadState, nullptr, thread->mReturnValues);
+		int scriptResult = RunThread(thread, thread->mReturnValues);
 		thread->mReturnValues = 0;
 		if (scriptResult != LUA_YIELD) {
-			deadThreads.push_back(thread);
+			mDeadThreads.push_back(thread);
 			if (scriptResult != 0) {
 				char const * string = lua_tostring(threadState, -1);
 				fprintf(stderr, "%s", string);
@@ -125,38 +183,89 @@ void KEngineCore::LuaScheduler::Update() {
 			}
 		}
 	}
+	mNextThread = first + visited;
+	mFrameStats.mDeferred = runningCount - visited;
+	mFrameStats.mElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	mUpdating = false;
+
+	for (auto it = mKilledRunningThreads.begin(); it != mKilledRunningThreads.end(); it++) {
+		mRunningThreads.Erase(*it);
+	}
+	mKilledRunningThreads.clear();
+
+	for (auto it = mDeadThreads.begin(); it != mDeadThreads.end(); it++) {
+		ScheduledLuaThread * thread = *it;
+		if (thread->mPooled) {
+			ReleasePooledThread(thread, lua_status(thread->mThreadState) == LUA_OK);
+		} else {
+			KillThread(thread);
+		}
+	}
+	mDeadThreads.clear();
 
-	for (auto it = deadThreads.begin(); it != deadThreads.end(); it++) {
-		KillThread(*it);
+	if (mGarbageCollector != nullptr) {
+		//Whatever the threads left of the budget goes to the collector, which caps it at its own step budget
+		double leftover = mGarbageCollector->GetStepBudget();
+		if (timeBudget > 0.0) {
+			leftover = timeBudget - std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		auto collectStart = std::chrono::steady_clock::now();
+		mGarbageCollector->Step(leftover);
+		mFrameStats.mCollecting = std::chrono::duration<double>(std::chrono::steady_clock::now() - collectStart).count();
 	}
 }
 
 KEngineCore::ScheduledLuaThread * KEngineCore::LuaScheduler::GetScheduledThread(lua_State * thread)
 {
-	return mAllThreads[thread];
+	return *(ScheduledLuaThread **)lua_getextraspace(thread);
+}
+
+size_t KEngineCore::LuaScheduler::GetAllocationCount() const
+{
+	return mAllocations;
+}
+
+void * KEngineCore::LuaScheduler::CountAllocation(void * userData, void * pointer, size_t oldSize, size_t newSize)
+{
+	LuaScheduler * scheduler = (LuaScheduler *)userData;
+	if (newSize > 0 && (pointer == nullptr || newSize > oldSize)) {
+		scheduler->mAllocations++;
+	}
+	return scheduler->mAllocator(scheduler->mAllocatorUserData, pointer, oldSize, newSize);
+}
+
+int KEngineCore::LuaScheduler::LoadScript(lua_State * luaState, char const * scriptPath)
+{
+	return mChunkCache.Load(luaState, scriptPath);
+}
+
+KEngineCore::LuaChunkCache & KEngineCore::LuaScheduler::GetChunkCache()
+{
+	return mChunkCache;
 }
 
 static int create(lua_State * luaState) {
 	KEngineCore::LuaScheduler * scheduler = (KEngineCore::LuaScheduler *)lua_touserdata(luaState, lua_upvalueindex(1));
-	KEngineCore::ScheduledLuaThread * scheduledThread = new (lua_newuserdata(luaState, sizeof(KEngineCore::ScheduledLuaThread))) KEngineCore::ScheduledLuaThread;
-	lua_checkstack(luaState, 1);
-	luaL_getmetatable(luaState, "KEngineCore.ScheduledThread");
-	lua_setmetatable(luaState, -2);
 	
-	char const * fileName = luaL_optstring(luaState, 1, nullptr);
-	if (fileName != nullptr) {
-        KEngineCore::TextFile file;
-        file.LoadFromFile(fileName, ".lua");
-		int val = luaL_loadbuffer(luaState, file.GetContents().c_str(), file.GetContents().length(), fileName); //TODO: Check return value
+	if (lua_type(luaState, 1) == LUA_TSTRING) {
+		if (scheduler->LoadScript(luaState, lua_tostring(luaState, 1)) != LUA_OK) {
+			return lua_error(luaState);
+		}
 	} else {
 		luaL_checktype(luaState, 1, LUA_TFUNCTION);
 		lua_checkstack(luaState, 1);
 		lua_pushvalue(luaState, 1);
 	}
+
+	KEngineCore::ScheduledLuaThread * scheduledThread = new (lua_newuserdata(luaState, sizeof(KEngineCore::ScheduledLuaThread))) KEngineCore::ScheduledLuaThread;
+	lua_checkstack(luaState, 1);
+	luaL_getmetatable(luaState, "KEngineCore.ScheduledThread");
+	lua_setmetatable(luaState, -2);
 			
 	lua_State * thread = lua_newthread(luaState);	
 	lua_checkstack(luaState, 1);
-	lua_xmove(luaState, scheduledThread->GetThreadState(), 1); //move the function from the parent thread to the child
+	lua_pushvalue(luaState, -3);
+	lua_xmove(luaState, thread, 1); //move the function from the parent thread to the child
 	scheduledThread->Init(scheduler, thread);
 
 	lua_pop(luaState, 1);  // Pop the raw thread, it has been copied to the registry.
@@ -230,7 +339,6 @@ struct CallbackChunk {
 };
 }
 
-//This callback doesn't work (tries to run a thread instead of a function?)  and if it did the callback would be non-reentrant!  MUST FIX!
 KEngineCore::ScheduledLuaCallback KEngineCore::LuaScheduler::CreateCallback(lua_State * luaState, int callbackIndex) 
 {	
 	assert(mMainState);
@@ -245,24 +353,10 @@ KEngineCore::ScheduledLuaCallback KEngineCore::LuaScheduler::CreateCallback(lua_
 	callbackChunk->mScheduler = this;
 	callbackChunk->mFunctionRegistryIndex = functionRegistryIndex;  //Register the function
 	callbackChunk->mSelfRegistryIndex = luaL_ref(luaState, LUA_REGISTRYINDEX);  //Register callback chunk
-	
-	
-		
+
+	//Each invocation gets its own pooled thread, so the callback is reentrant
 	auto cb = [callbackChunk] () {
-			lua_State * luaState = callbackChunk->mScheduler->GetMainState();
-			KEngineCore::ScheduledLuaThread * scheduledThread = new (lua_newuserdata(luaState, sizeof(KEngineCore::ScheduledLuaThread))) KEngineCore::ScheduledLuaThread;
-			luaL_getmetatable(luaState, "KEngineCore.ScheduledThread");
-			lua_setmetatable(luaState, -2);
-
-			lua_State * thread = lua_newthread(luaState);
-			lua_rawgeti(luaState, LUA_REGISTRYINDEX, callbackChunk->mFunctionRegistryIndex); //get the function
-			luaL_checktype(luaState, -1, LUA_TFUNCTION); //check for a function
-			lua_xmove(luaState, thread, 1); //move the function from the parent thread to the child
-
-			scheduledThread->Init(callbackChunk->mScheduler, thread);
-			lua_pop(luaState, 1); //Pop the thread off the stack now that it's been wrapped
-			scheduledThread->SetRegistryIndex(luaL_ref(luaState, LUA_REGISTRYINDEX));  //This pops the wrapped thread and copies it to the registry as well
-			scheduledThread->Resume();
+			callbackChunk->mScheduler->RunCallback(callbackChunk->mFunctionRegistryIndex);
 		};
 
 	auto cancel = [callbackChunk] () {
@@ -278,6 +372,117 @@ KEngineCore::ScheduledLuaCallback KEngineCore::LuaScheduler::CreateCallback(lua_
 	return retVal;
 }
 
+void KEngineCore::LuaScheduler::RunCallback(int functionRegistryIndex)
+{
+	ScheduledLuaThread * thread = AcquirePooledThread();
+	lua_State * threadState = thread->mThreadState;
+	lua_rawgeti(threadState, LUA_REGISTRYINDEX, functionRegistryIndex);
+
+	//Run it right away; most callbacks finish without ever yielding
+	int scriptResult = RunThread(thread, 0);
+	if (scriptResult == LUA_YIELD) {
+		//It yielded, so from here on it's an ordinary running thread.  Anything it queued (a pause from waits, say) is applied at the next Update as usual.
+		thread->mRunningHandle = mRunningThreads.Insert(thread);
+	} else {
+		if (scriptResult != 0) {
+			char const * string = lua_tostring(threadState, -1);
+			fprintf(stderr, "%s", string);
+			lua_pop(threadState, 1);
+			assert(0);
+		}
+		ReleasePooledThread(thread, scriptResult == 0);
+	}
+}
+
+int KEngineCore::LuaScheduler::RunThread(ScheduledLuaThread * thread, int arguments)
+{
+	lua_State * threadState = thread->mThreadState;
+	if (mInstructionSlice > 0) {
+		lua_sethook(threadState, PreemptHook, LUA_MASKCOUNT, mInstructionSlice);  //Also restarts the count, so every resume gets a full slice
+		thread->mHooked = true;
+	} else if (thread->mHooked) {
+		lua_sethook(threadState, nullptr, 0, 0);
+		thread->mHooked = false;
+	}
+	thread->mPreempted = false;
+
+	int scriptResult = lua_resume(threadState, nullptr, arguments);
+	mFrameStats.mResumed++;
+	if (thread->mPreempted) {
+		mFrameStats.mPreempted++;
+	}
+	return scriptResult;
+}
+
+void KEngineCore::LuaScheduler::PreemptHook(lua_State * luaState, lua_Debug *)
+{
+	//Can't yield from inside a metamethod or a C call, so those get until the next count to finish up
+	ScheduledLuaThread * thread = *(ScheduledLuaThread **)lua_getextraspace(luaState);
+	if (thread != nullptr && lua_isyieldable(luaState)) {
+		thread->mPreempted = true;
+		lua_yield(luaState, 0);
+	}
+}
+
+void KEngineCore::LuaScheduler::SetGarbageCollector(LuaGarbageCollector * collector)
+{
+	mGarbageCollector = collector;
+}
+
+void KEngineCore::LuaScheduler::SetInstructionSlice(int instructions)
+{
+	mInstructionSlice = instructions;
+}
+
+KEngineCore::LuaSchedulerFrameStats const & KEngineCore::LuaScheduler::GetFrameStats() const
+{
+	return mFrameStats;
+}
+
+KEngineCore::ScheduledLuaThread * KEngineCore::LuaScheduler::AcquirePooledThread()
+{
+	if (!mFreeThreads.empty()) {
+		ScheduledLuaThread * thread = mFreeThreads.back();
+		mFreeThreads.pop_back();
+		return thread;
+	}
+
+	ScheduledLuaThread * thread = new ScheduledLuaThread;
+	thread->mPooled = true;
+	lua_checkstack(mMainState, 1);
+	lua_State * threadState = lua_newthread(mMainState);
+	thread->Init(this, threadState);  //Anchors the thread state in the registry for as long as the pool holds it
+	lua_pop(mMainState, 1);
+	mPooledThreads.push_back(thread);
+	return thread;
+}
+
+void KEngineCore::LuaScheduler::ForgetPending(ScheduledLuaThread * thread)
+{
+	mPausingThreads.erase(std::remove(mPausingThreads.begin(), mPausingThreads.end(), thread), mPausingThreads.end());
+	mResumingThreads.erase(std::remove(mResumingThreads.begin(), mResumingThreads.end(), thread), mResumingThreads.end());
+}
+
+void KEngineCore::LuaScheduler::ReleasePooledThread(ScheduledLuaThread * thread, bool reusable)
+{
+	assert(thread->mPooled);
+	mRunningThreads.Erase(thread->mRunningHandle);
+	thread->mRunningHandle = SlotMapHandle();
+	thread->Unschedule();
+	if (reusable) {
+		//A coroutine that returned normally can be handed a new function, as long as nothing it queued outlives it
+		ForgetPending(thread);
+		lua_settop(thread->mThreadState, 0);
+		thread->mReturnValues = 0;
+		mFreeThreads.push_back(thread);
+	} else {
+		//One that died with an error can't be resumed again, so let it go
+		KillThread(thread);
+		mPooledThreads.erase(std::find(mPooledThreads.begin(), mPooledThreads.end(), thread));
+		delete thread;
+	}
+}
+
 KEngineCore::ScheduledLuaThread::ScheduledLuaThread()
 {
 	mScheduler = nullptr;
@@ -304,9 +509,7 @@ void KEngineCore::ScheduledLuaThread::Init(LuaScheduler * scheduler, char const
 	lua_State * mainState = scheduler->GetMainState();
 	lua_State * thread = lua_newthread(mainState);
     
-    KEngineCore::TextFile file;
-    file.LoadFromFile(fileName, ".lua");
-    int val = luaL_loadbuffer(thread, file.GetContents().c_str(), file.GetContents().length(), fileName); //TODO: Check return value
+    int val = scheduler->LoadScript(thread, fileName);
 	char const * string;
 	switch (val) {
 		case LUA_ERRSYNTAX: ///syntax error during pre-compilation;
@@ -360,6 +563,15 @@ void KEngineCore::ScheduledLuaThread::Kill()
 	mScheduler->KillThread(this);
 }
 
+void KEngineCore::ScheduledLuaThread::Expire()
+{
+#ifndef NDEBUG
+	size_t allocations = mScheduler->GetAllocationCount();
+#endif
+	Resume();
+	assert(mScheduler->GetAllocationCount() == allocations);  //Waking a sleeper only requeues it
+}
+
 void KEngineCore::ScheduledLuaThread::SetRegistryIndex(int registryIndex)
 {
 	mRegistryIndex = registryIndex;
@@ -377,6 +589,11 @@ lua_State * KEngineCore::ScheduledLuaThread::GetThreadState() const
 	return mThreadState;
 }
 
+bool KEngineCore::ScheduledLuaThread::IsAlive() const
+{
+	return mScheduler != nullptr && mAllThreadsIndex != SIZE_MAX;
+}
+
 KEngineCore::LuaScheduler * KEngineCore::ScheduledLuaThread::GetLuaScheduler() const
 {
 	assert(mScheduler != nullptr);
@@ -1,32 +1,54 @@
 #pragma once
 
-#include <map>
-#include <list>
 #include <vector>
 #include <functional>
+#include <cstdint>
 #include "LuaLibrary.h"
+#include "TimingWheel.h"
+#include "SlotMap.h"
+#include "LuaChunkCache.h"
 
 struct lua_State;
+struct lua_Debug;
 
 namespace KEngineCore {
 
 class ScheduledLuaThread;
+class LuaGarbageCollector;
 
 struct ScheduledLuaCallback {
     std::function<void ()> mCallback;
     std::function<void ()> mCancelCallback;
 };
 
+struct LuaSchedulerFrameStats {
+	size_t	mResumed {0};
+	size_t	mDeferred {0};	///Running threads left for the next Update because the time budget ran out
+	size_t	mPreempted {0};	///Threads forced to yield by the instruction slice
+	double	mElapsed {0.0};
+	double	mCollecting {0.0};	///Time the garbage collector was given after the threads ran
+};
+
 class LuaScheduler : protected LuaLibrary
 {
 public:
 	LuaScheduler(void);
 	virtual ~LuaScheduler(void);
 
-	void Init();
+	///With no allocator the state uses Lua's default realloc-based one.  A custom allocator must outlive Deinit.
+	void Init(lua_Alloc allocator = nullptr, void * allocatorUserData = nullptr);
 	void Deinit();
 
-	void Update();
+	///With a positive timeBudget (in seconds), stops resuming threads once it's spent and carries on round-robin next Update
+	void Update(double timeBudget = 0.0);
+
+	///Hands garbage collection to the collector: it steps in the time Update has left over, and checks its emergency threshold between resumes.
+	///The collector should already be initialized on GetMainState(); Deinit deinitializes it along with the state.
+	void SetGarbageCollector(LuaGarbageCollector * collector);
+
+	///Forces a thread to yield after this many VM instructions in one resume; 0 turns preemption off
+	void SetInstructionSlice(int instructions);
+	LuaSchedulerFrameStats const & GetFrameStats() const;
 
 	lua_State * GetMainState() const;
 	
@@ -39,18 +61,48 @@ public:
 
 	ScheduledLuaThread * GetScheduledThread(lua_State * thread);
 
+	///Pushes the compiled script (through the chunk cache) or an error message onto luaState; returns the lua_load status
+	int LoadScript(lua_State * luaState, char const * scriptPath);
+	LuaChunkCache & GetChunkCache();
+
+	///Allocations the state has made through its allocator since Init.  Only counted in debug builds; always 0 with NDEBUG.
+	///This only sees Lua allocations; Tools/WaitsAllocationCheck also counts operator new across a steady waits loop.
+	size_t GetAllocationCount() const;
+
 private:
 	void ScheduleThread(ScheduledLuaThread * thread, bool running);
+	void RunCallback(int functionRegistryIndex);
+	ScheduledLuaThread * AcquirePooledThread();
+	void ReleasePooledThread(ScheduledLuaThread * thread, bool reusable);
+	void ForgetPending(ScheduledLuaThread * thread);
+	int RunThread(ScheduledLuaThread * thread, int arguments);
+	static void PreemptHook(lua_State * luaState, lua_Debug * debug);
+	static void * CountAllocation(void * userData, void * pointer, size_t oldSize, size_t newSize);
+
     lua_State *	mMainState {nullptr};
 	std::vector<ScheduledLuaThread *>			mResumingThreads;
 	std::vector<ScheduledLuaThread *>			mPausingThreads;
-	std::list<ScheduledLuaThread *>				mRunningThreads;
-	std::map<lua_State *, ScheduledLuaThread *>	mAllThreads;
+	SlotMap<ScheduledLuaThread *>				mRunningThreads;
+	std::vector<SlotMapHandle>					mKilledRunningThreads;	///Running entries killed mid-Update, erased once it's done iterating
+	std::vector<ScheduledLuaThread *>			mDeadThreads;
+	std::vector<ScheduledLuaThread *>			mAllThreads;
+	std::vector<ScheduledLuaThread *>			mPooledThreads;	///Every thread the scheduler allocated for callbacks
+	std::vector<ScheduledLuaThread *>			mFreeThreads;	///Pooled threads ready to run a callback
+	bool										mUpdating {false};
+	size_t										mNextThread {0};	///Round-robin position for budgeted updates
+	int											mInstructionSlice {0};
+	LuaSchedulerFrameStats						mFrameStats;
+	LuaGarbageCollector *						mGarbageCollector {nullptr};
+	LuaChunkCache								mChunkCache;
+	lua_Alloc									mAllocator {nullptr};	///The state's own allocator, which CountAllocation forwards to in debug builds
+	void *										mAllocatorUserData {nullptr};
+	size_t										mAllocations {0};
 
 	friend class ScheduledLuaThread;
 };
 
-class ScheduledLuaThread
+///A scheduled thread can park itself directly in a Timer's wheel, and is resumed when it expires
+class ScheduledLuaThread : public TimingWheelNode
 {
 public:
 	ScheduledLuaThread();
@@ -69,13 +121,24 @@ public:
 	LuaScheduler * GetLuaScheduler() const;
 
 	lua_State * GetThreadState() const;
+
+	///False once the thread has finished or been killed
+	bool IsAlive() const;
+
+protected:
+	void Expire() override;
+
 private:
 
     LuaScheduler *								mScheduler {nullptr};
     lua_State *									mThreadState {nullptr};
-	std::list<ScheduledLuaThread *>::iterator	mPosition;
+	SlotMapHandle								mRunningHandle;
+	size_t										mAllThreadsIndex {SIZE_MAX};
 	int											mRegistryIndex {-1};
 	int											mReturnValues {-1};
+	bool										mPooled {false};
+	bool										mHooked {false};
+	bool										mPreempted {false};
 
 	friend class LuaScheduler;
 };
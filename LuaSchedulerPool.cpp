@@ -0,0 +1,622 @@
+#include "LuaSchedulerPool.h"
+#include "LuaScheduler.h"
+#include "LuaLibrary.h"
+#include "LuaPoolAllocator.h"
+#include "Lua/lua.hpp"
+#include <assert.h>
+#include <thread>
+#include <algorithm>
+#include <deque>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+namespace KEngineCore {
+
+struct LuaPoolSpawn {
+	std::string		mScriptPath;
+	std::string		mArguments;	///Serialized value passed to the script as ..., empty for none
+};
+
+struct LuaPoolMessage {
+	std::string		mData;
+	int				mSender {LuaSchedulerPool::kHostSender};
+};
+
+class LuaSchedulerPoolWorker : public LuaLibrary
+{
+public:
+	virtual void RegisterLibrary(lua_State * luaState, char const * name = "pool") override;
+
+	void RunFrame(double timeBudget);
+	void DeliverMessages();
+	void StartSpawn(LuaPoolSpawn const & spawn);
+	void ReapFinished();
+	void QueueSpawn(int target, std::string && scriptPath, std::string && arguments);
+	void Send(unsigned int target, std::string && data);
+
+	LuaSchedulerPool *		mPool {nullptr};
+	unsigned int			mIndex {0};
+	LuaPoolAllocator		mAllocator;		///Only this worker's state allocates from it, so it needs no locking
+	LuaScheduler			mScheduler;
+	std::thread				mThread;
+
+	//Shared with the host and the other workers, under mQueueMutex
+	std::mutex								mQueueMutex;
+	std::deque<LuaPoolSpawn>				mSpawns;		///Up for stealing
+	std::deque<LuaPoolSpawn>				mPinnedSpawns;
+	std::vector<LuaPoolMessage>				mMailbox;
+
+	//Only touched by this worker's thread during a frame
+	std::deque<LuaPoolMessage>				mInbox;
+	std::deque<int>							mReceivers;	///Registry references to threads parked in pool.receive
+	std::vector<std::unique_ptr<ScheduledLuaThread>>	mSpawned;
+	LuaSchedulerWorkerStats					mStats;
+
+	std::atomic<size_t>						mLoad {0};	///mSpawned.size(), for the other workers to read
+};
+
+}
+
+//Message encoding: a tag byte per value, numbers and lengths in native byte order (states only talk within a process)
+enum : char {
+	kTagNil,
+	kTagFalse,
+	kTagTrue,
+	kTagNumber,
+	kTagString,
+	kTagTable,
+	kTagEnd
+};
+
+static const int maxTableDepth = 32;
+
+static void serializeString(char const * string, size_t length, std::string & data) {
+	uint32_t length32 = (uint32_t)length;
+	data.push_back(kTagString);
+	data.append((char const *)&length32, sizeof(length32));
+	data.append(string, length);
+}
+
+//Raises the error serializeValue would otherwise hit partway through.  Lua here is built as C, so luaL_error longjmps,
+//and has to be raised before there's a std::string on the C++ side whose destructor it would skip.
+static void checkSendable(lua_State * luaState, int index, int depth) {
+	index = lua_absindex(luaState, index);
+	switch (lua_type(luaState, index)) {
+		case LUA_TNONE:
+		case LUA_TNIL:
+		case LUA_TBOOLEAN:
+		case LUA_TNUMBER:
+		case LUA_TSTRING:
+			break;
+		case LUA_TTABLE:
+			if (depth >= maxTableDepth) {
+				luaL_error(luaState, "can't send tables nested more than %d deep (is it cyclic?)", maxTableDepth);
+			}
+			luaL_checkstack(luaState, 2, "table too deep to send");
+			lua_pushnil(luaState);
+			while (lua_next(luaState, index) != 0) {
+				checkSendable(luaState, -2, depth + 1);
+				checkSendable(luaState, -1, depth + 1);
+				lua_pop(luaState, 1);
+			}
+			break;
+		default:
+			luaL_error(luaState, "can't send a %s between Lua states", luaL_typename(luaState, index));
+			break;
+	}
+}
+
+//The value must have passed checkSendable
+static void serializeValue(lua_State * luaState, int index, std::string & data, int depth) {
+	index = lua_absindex(luaState, index);
+	switch (lua_type(luaState, index)) {
+		case LUA_TNONE:
+		case LUA_TNIL:
+			data.push_back(kTagNil);
+			break;
+		case LUA_TBOOLEAN:
+			data.push_back(lua_toboolean(luaState, index) ? kTagTrue : kTagFalse);
+			break;
+		case LUA_TNUMBER: {
+			lua_Number number = lua_tonumber(luaState, index);
+			data.push_back(kTagNumber);
+			data.append((char const *)&number, sizeof(number));
+			break;
+		}
+		case LUA_TSTRING: {
+			size_t length;
+			char const * string = lua_tolstring(luaState, index, &length);
+			serializeString(string, length, data);
+			break;
+		}
+		case LUA_TTABLE:
+			assert(depth < maxTableDepth);
+			data.push_back(kTagTable);
+			lua_checkstack(luaState, 2);
+			lua_pushnil(luaState);
+			while (lua_next(luaState, index) != 0) {
+				serializeValue(luaState, -2, data, depth + 1);
+				serializeValue(luaState, -1, data, depth + 1);
+				lua_pop(luaState, 1);
+			}
+			data.push_back(kTagEnd);
+			break;
+		default:
+			assert(0);
+			break;
+	}
+}
+
+static size_t deserializeValue(lua_State * luaState, std::string const & data, size_t offset) {
+	lua_checkstack(luaState, 3);
+	char tag = data[offset++];
+	switch (tag) {
+		case kTagFalse:
+		case kTagTrue:
+			lua_pushboolean(luaState, tag == kTagTrue);
+			break;
+		case kTagNumber: {
+			lua_Number number;
+			memcpy(&number, data.data() + offset, sizeof(number));
+			offset += sizeof(number);
+			lua_pushnumber(luaState, number);
+			break;
+		}
+		case kTagString: {
+			uint32_t length;
+			memcpy(&length, data.data() + offset, sizeof(length));
+			offset += sizeof(length);
+			lua_pushlstring(luaState, data.data() + offset, length);
+			offset += length;
+			break;
+		}
+		case kTagTable:
+			lua_newtable(luaState);
+			while (data[offset] != kTagEnd) {
+				offset = deserializeValue(luaState, data, offset);  //Key
+				offset = deserializeValue(luaState, data, offset);  //Value
+				lua_rawset(luaState, -3);
+			}
+			offset++;
+			break;
+		default:
+			lua_pushnil(luaState);
+			break;
+	}
+	return offset;
+}
+
+static int pushMessage(lua_State * luaState, KEngineCore::LuaPoolMessage const & message) {
+	deserializeValue(luaState, message.mData, 0);
+	lua_pushinteger(luaState, message.mSender);
+	return 2;
+}
+
+KEngineCore::LuaSchedulerPool::LuaSchedulerPool()
+{
+}
+
+KEngineCore::LuaSchedulerPool::~LuaSchedulerPool()
+{
+	Deinit();
+}
+
+void KEngineCore::LuaSchedulerPool::Init(unsigned int workerCount, WorkerSetup setup, WorkerFrame frame)
+{
+	assert(mWorkers.empty());
+	if (workerCount == 0) {
+		workerCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	mWorkerFrame = frame;
+	mQuitting = false;
+	mFrame = 0;
+
+	//States are created here and only ever used by one thread at a time after that, so they needn't be created on their workers
+	for (unsigned int index = 0; index < workerCount; index++) {
+		LuaSchedulerPoolWorker * worker = new LuaSchedulerPoolWorker;
+		worker->mPool = this;
+		worker->mIndex = index;
+		worker->mScheduler.Init(LuaPoolAllocator::Alloc, &worker->mAllocator);
+		worker->RegisterLibrary(worker->mScheduler.GetMainState());
+		if (setup) {
+			setup(&worker->mScheduler, index);
+		}
+		mWorkers.emplace_back(worker);
+	}
+	for (auto it = mWorkers.begin(); it != mWorkers.end(); it++) {
+		(*it)->mThread = std::thread(&LuaSchedulerPool::WorkerMain, this, it->get());
+	}
+}
+
+void KEngineCore::LuaSchedulerPool::Deinit()
+{
+	if (mWorkers.empty()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mFrameMutex);
+		mQuitting = true;
+	}
+	mFrameStart.notify_all();
+	for (auto it = mWorkers.begin(); it != mWorkers.end(); it++) {
+		(*it)->mThread.join();
+	}
+	for (auto it = mWorkers.begin(); it != mWorkers.end(); it++) {
+		LuaSchedulerPoolWorker * worker = it->get();
+		worker->mSpawned.clear();  //Kills them, which needs the scheduler still up
+		worker->mScheduler.Deinit();
+	}
+	mWorkers.clear();
+	mWorkerFrame = nullptr;
+}
+
+void KEngineCore::LuaSchedulerPool::Update(double timeBudget)
+{
+	if (mWorkers.empty()) {
+		return;
+	}
+	std::unique_lock<std::mutex> lock(mFrameMutex);
+	mFrameBudget = timeBudget;
+	mPendingWorkers = (unsigned int)mWorkers.size();
+	mFrame++;
+	mFrameStart.notify_all();
+	mFrameDone.wait(lock, [this] () { return mPendingWorkers == 0; });
+}
+
+void KEngineCore::LuaSchedulerPool::Spawn(char const * scriptPath, int worker)
+{
+	assert(!mWorkers.empty());
+	assert(worker == kAnyWorker || (worker >= 0 && worker < (int)mWorkers.size()));
+	if (worker == kAnyWorker) {
+		QueueSpawn(mNextWorker++ % mWorkers.size(), false, scriptPath, std::string());
+	} else {
+		QueueSpawn((unsigned int)worker, true, scriptPath, std::string());
+	}
+}
+
+void KEngineCore::LuaSchedulerPool::Send(unsigned int worker, std::string const & text)
+{
+	assert(worker < mWorkers.size());
+	std::string data;
+	serializeString(text.data(), text.length(), data);
+	Post(worker, std::move(data), kHostSender);
+}
+
+unsigned int KEngineCore::LuaSchedulerPool::GetWorkerCount() const
+{
+	return (unsigned int)mWorkers.size();
+}
+
+KEngineCore::LuaScheduler * KEngineCore::LuaSchedulerPool::GetScheduler(unsigned int worker) const
+{
+	assert(worker < mWorkers.size());
+	return &mWorkers[worker]->mScheduler;
+}
+
+KEngineCore::LuaAllocatorStats const & KEngineCore::LuaSchedulerPool::GetAllocatorStats(unsigned int worker) const
+{
+	assert(worker < mWorkers.size());
+	return mWorkers[worker]->mAllocator.GetStats();
+}
+
+KEngineCore::LuaSchedulerWorkerStats const & KEngineCore::LuaSchedulerPool::GetWorkerStats(unsigned int worker) const
+{
+	assert(worker < mWorkers.size());
+	return mWorkers[worker]->mStats;
+}
+
+void KEngineCore::LuaSchedulerPool::WorkerMain(LuaSchedulerPoolWorker * worker)
+{
+	unsigned long long frame = 0;
+	std::unique_lock<std::mutex> lock(mFrameMutex);
+	while (true) {
+		mFrameStart.wait(lock, [this, &frame] () { return mQuitting || mFrame != frame; });
+		if (mQuitting) {
+			break;
+		}
+		frame = mFrame;
+		double timeBudget = mFrameBudget;
+		lock.unlock();
+
+		worker->RunFrame(timeBudget);
+
+		lock.lock();
+		if (--mPendingWorkers == 0) {
+			mFrameDone.notify_one();
+		}
+	}
+}
+
+void KEngineCore::LuaSchedulerPool::QueueSpawn(unsigned int worker, bool pinned, std::string && scriptPath, std::string && arguments)
+{
+	LuaSchedulerPoolWorker * target = mWorkers[worker].get();
+	LuaPoolSpawn spawn = {std::move(scriptPath), std::move(arguments)};
+	std::lock_guard<std::mutex> lock(target->mQueueMutex);
+	(pinned ? target->mPinnedSpawns : target->mSpawns).push_back(std::move(spawn));
+}
+
+void KEngineCore::LuaSchedulerPool::Post(unsigned int worker, std::string && data, int sender)
+{
+	LuaSchedulerPoolWorker * target = mWorkers[worker].get();
+	LuaPoolMessage message = {std::move(data), sender};
+	std::lock_guard<std::mutex> lock(target->mQueueMutex);
+	target->mMailbox.push_back(std::move(message));
+}
+
+bool KEngineCore::LuaSchedulerPool::Steal(LuaSchedulerPoolWorker * thief)
+{
+	//Take the newest spawn from the first worker that has any, starting after the thief so the victims spread out
+	size_t workerCount = mWorkers.size();
+	for (size_t offset = 1; offset < workerCount; offset++) {
+		LuaSchedulerPoolWorker * victim = mWorkers[(thief->mIndex + offset) % workerCount].get();
+		LuaPoolSpawn spawn;
+		{
+			std::lock_guard<std::mutex> lock(victim->mQueueMutex);
+			if (victim->mSpawns.empty()) {
+				continue;
+			}
+			spawn = std::move(victim->mSpawns.back());
+			victim->mSpawns.pop_back();
+		}
+		{
+			std::lock_guard<std::mutex> lock(thief->mQueueMutex);
+			thief->mSpawns.push_back(std::move(spawn));
+		}
+		thief->mStats.mStolen++;
+		return true;
+	}
+	return false;
+}
+
+size_t KEngineCore::LuaSchedulerPool::GetFairShare() const
+{
+	//Running threads plus queued spawns, spread evenly.  Adopting a spawn moves it from one to the other, so this holds steady through a frame.
+	size_t total = 0;
+	for (auto it = mWorkers.begin(); it != mWorkers.end(); it++) {
+		LuaSchedulerPoolWorker * worker = it->get();
+		std::lock_guard<std::mutex> lock(worker->mQueueMutex);
+		total += worker->mLoad + worker->mSpawns.size() + worker->mPinnedSpawns.size();
+	}
+	return (total + mWorkers.size() - 1) / mWorkers.size();
+}
+
+void KEngineCore::LuaSchedulerPoolWorker::RunFrame(double timeBudget)
+{
+	auto start = std::chrono::steady_clock::now();
+	mStats = LuaSchedulerWorkerStats();
+	if (mPool->mWorkerFrame) {
+		mPool->mWorkerFrame(&mScheduler, mIndex);
+	}
+	DeliverMessages();
+
+	//Pinned spawns always start here.  The rest are balanced on load rather than on who gets to them first, since starting one
+	//is cheap next to running it: a worker takes spawns (its own, or stolen once its own queue is dry) until it's running its
+	//fair share of threads.  Every worker does this at the top of the frame, so a burst spawned on one worker last frame is
+	//spread across all of them.
+	std::deque<LuaPoolSpawn> pinned;
+	{
+		std::lock_guard<std::mutex> lock(mQueueMutex);
+		pinned.swap(mPinnedSpawns);
+	}
+	for (auto it = pinned.begin(); it != pinned.end(); it++) {
+		StartSpawn(*it);
+	}
+	size_t share = mPool->GetFairShare();
+	while (mLoad < share) {
+		if (timeBudget > 0.0 && mStats.mSpawned > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= timeBudget) {
+			break;
+		}
+		LuaPoolSpawn spawn;
+		{
+			std::lock_guard<std::mutex> lock(mQueueMutex);
+			if (!mSpawns.empty()) {
+				spawn = std::move(mSpawns.front());
+				mSpawns.pop_front();
+			}
+		}
+		if (spawn.mScriptPath.empty()) {
+			if (!mPool->Steal(this)) {
+				break;
+			}
+			continue;
+		}
+		StartSpawn(spawn);
+	}
+
+	//Whatever budget the spawns left goes to running threads
+	double remaining = 0.0;
+	if (timeBudget > 0.0) {
+		remaining = std::max(timeBudget - std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 1e-6);
+	}
+	mScheduler.Update(remaining);
+	ReapFinished();
+
+	mStats.mRunning = mSpawned.size();
+	mStats.mElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void KEngineCore::LuaSchedulerPoolWorker::DeliverMessages()
+{
+	std::vector<LuaPoolMessage> mailbox;
+	{
+		std::lock_guard<std::mutex> lock(mQueueMutex);
+		mailbox.swap(mMailbox);
+	}
+	for (auto it = mailbox.begin(); it != mailbox.end(); it++) {
+		mInbox.push_back(std::move(*it));
+	}
+	mStats.mMessages = mailbox.size();
+
+	//Hand messages straight to threads already waiting in pool.receive; they pick up next Update
+	lua_State * mainState = mScheduler.GetMainState();
+	while (!mInbox.empty() && !mReceivers.empty()) {
+		int receiverRef = mReceivers.front();
+		mReceivers.pop_front();
+		lua_checkstack(mainState, 1);
+		lua_rawgeti(mainState, LUA_REGISTRYINDEX, receiverRef);
+		lua_State * threadState = lua_tothread(mainState, -1);
+		lua_pop(mainState, 1);
+		luaL_unref(mainState, LUA_REGISTRYINDEX, receiverRef);
+
+		ScheduledLuaThread * receiver = mScheduler.GetScheduledThread(threadState);
+		if (receiver == nullptr) {
+			continue;  //Killed while it waited
+		}
+		int values = pushMessage(threadState, mInbox.front());
+		mInbox.pop_front();
+		receiver->Resume(values);
+	}
+}
+
+void KEngineCore::LuaSchedulerPoolWorker::StartSpawn(LuaPoolSpawn const & spawn)
+{
+	lua_State * mainState = mScheduler.GetMainState();
+	lua_checkstack(mainState, 1);
+	lua_State * threadState = lua_newthread(mainState);
+	if (mScheduler.LoadScript(threadState, spawn.mScriptPath.c_str()) != LUA_OK) {
+		fprintf(stderr, "Spawn Error: %s\n", lua_tostring(threadState, -1));
+		lua_pop(mainState, 1);
+		return;
+	}
+	int arguments = 0;
+	if (!spawn.mArguments.empty()) {
+		deserializeValue(threadState, spawn.mArguments, 0);
+		arguments = 1;
+	}
+
+	ScheduledLuaThread * thread = new ScheduledLuaThread;
+	thread->Init(&mScheduler, threadState);
+	lua_pop(mainState, 1);  //Anchored in the registry now
+	thread->Resume(arguments);
+	mSpawned.emplace_back(thread);
+	mLoad = mSpawned.size();
+	mStats.mSpawned++;
+}
+
+void KEngineCore::LuaSchedulerPoolWorker::ReapFinished()
+{
+	for (size_t index = 0; index < mSpawned.size();) {
+		if (mSpawned[index]->IsAlive()) {
+			index++;
+		} else {
+			mSpawned[index] = std::move(mSpawned.back());
+			mSpawned.pop_back();
+		}
+	}
+	mLoad = mSpawned.size();
+}
+
+void KEngineCore::LuaSchedulerPoolWorker::QueueSpawn(int target, std::string && scriptPath, std::string && arguments)
+{
+	//Unpinned spawns go on our own queue; idle workers will steal them if we're busy
+	bool pinned = target != LuaSchedulerPool::kAnyWorker;
+	mPool->QueueSpawn(pinned ? (unsigned int)target : mIndex, pinned, std::move(scriptPath), std::move(arguments));
+}
+
+void KEngineCore::LuaSchedulerPoolWorker::Send(unsigned int target, std::string && data)
+{
+	mPool->Post(target, std::move(data), (int)mIndex);
+}
+
+static KEngineCore::LuaSchedulerPoolWorker * getWorker(lua_State * luaState) {
+	return (KEngineCore::LuaSchedulerPoolWorker *)lua_touserdata(luaState, lua_upvalueindex(1));
+}
+
+static int checkWorkerIndex(lua_State * luaState, int index, KEngineCore::LuaSchedulerPool * pool) {
+	int worker = luaL_checkint(luaState, index);
+	luaL_argcheck(luaState, worker >= 0 && worker < (int)pool->GetWorkerCount(), index, "no such worker");
+	return worker;
+}
+
+static int worker(lua_State * luaState) {
+	lua_pushinteger(luaState, getWorker(luaState)->mIndex);
+	return 1;
+}
+
+static int workers(lua_State * luaState) {
+	lua_pushinteger(luaState, getWorker(luaState)->mPool->GetWorkerCount());
+	return 1;
+}
+
+static int spawn(lua_State * luaState) {
+	KEngineCore::LuaSchedulerPoolWorker * self = getWorker(luaState);
+	char const * scriptPath = luaL_checkstring(luaState, 1);
+	int target = KEngineCore::LuaSchedulerPool::kAnyWorker;
+	if (!lua_isnoneornil(luaState, 2)) {
+		target = checkWorkerIndex(luaState, 2, self->mPool);
+	}
+	bool hasArguments = !lua_isnone(luaState, 3);
+	if (hasArguments) {
+		checkSendable(luaState, 3, 0);
+	}
+	std::string arguments;
+	if (hasArguments) {
+		serializeValue(luaState, 3, arguments, 0);
+	}
+	self->QueueSpawn(target, scriptPath, std::move(arguments));
+	return 0;
+}
+
+static int send(lua_State * luaState) {
+	KEngineCore::LuaSchedulerPoolWorker * self = getWorker(luaState);
+	int target = checkWorkerIndex(luaState, 1, self->mPool);
+	checkSendable(luaState, 2, 0);
+	std::string data;
+	serializeValue(luaState, 2, data, 0);
+	self->Send((unsigned int)target, std::move(data));
+	return 0;
+}
+
+static int receive(lua_State * luaState) {
+	KEngineCore::LuaSchedulerPoolWorker * self = getWorker(luaState);
+	if (!self->mInbox.empty()) {
+		int values = pushMessage(luaState, self->mInbox.front());
+		self->mInbox.pop_front();
+		return values;
+	}
+
+	KEngineCore::ScheduledLuaThread * scheduledThread = self->mScheduler.GetScheduledThread(luaState);
+	if (scheduledThread == nullptr) {
+		return luaL_error(luaState, "receive called outside of a scheduled thread");
+	}
+	lua_checkstack(luaState, 1);
+	lua_pushthread(luaState);
+	self->mReceivers.push_back(luaL_ref(luaState, LUA_REGISTRYINDEX));
+	scheduledThread->Pause();
+	return lua_yield(luaState, 0);  //Resumed with the message and its sender
+}
+
+static int poll(lua_State * luaState) {
+	KEngineCore::LuaSchedulerPoolWorker * self = getWorker(luaState);
+	if (self->mInbox.empty()) {
+		return 0;
+	}
+	int values = pushMessage(luaState, self->mInbox.front());
+	self->mInbox.pop_front();
+	return values;
+}
+
+static const struct luaL_Reg poolLibrary [] = {
+	{"worker", worker},
+	{"workers", workers},
+	{"spawn", spawn},
+	{"send", send},
+	{"receive", receive},
+	{"poll", poll},
+	{nullptr, nullptr}
+};
+
+static int luaopen_pool (lua_State * luaState) {
+	lua_checkstack(luaState, 2);
+	luaL_newlibtable(luaState, poolLibrary);
+	lua_pushvalue(luaState, lua_upvalueindex(1));
+	luaL_setfuncs(luaState, poolLibrary, 1);
+
+	return 1;
+};
+
+void KEngineCore::LuaSchedulerPoolWorker::RegisterLibrary(lua_State * luaState, char const * name) {
+	PreloadLibrary(luaState, name, luaopen_pool);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <string>
+
+struct lua_State;
+
+namespace KEngineCore {
+
+class LuaScheduler;
+class LuaSchedulerPoolWorker;
+struct LuaAllocatorStats;
+
+struct LuaSchedulerWorkerStats {
+	size_t	mRunning {0};	///Pool-spawned threads alive at the end of the frame
+	size_t	mSpawned {0};	///Spawns started this frame, stolen ones included
+	size_t	mStolen {0};	///Spawns taken from another worker's queue this frame
+	size_t	mMessages {0};	///Messages delivered this frame
+	double	mElapsed {0.0};
+};
+
+///Runs N isolated Lua states, each with its own LuaScheduler and LuaPoolAllocator, on N worker threads.  Update runs one frame on
+///every worker in parallel and returns once they've all finished.
+///
+///A coroutine can't move between lua_States, so balancing happens at spawn time: scripts spawned without an
+///affinity wait in a per-worker queue, and a worker running less than its share of threads steals queued spawns
+///from the others.  Spawns with an affinity are never stolen.
+///
+///States share nothing.  They talk through plain-data messages (nil, booleans, numbers, strings and tables of
+///those), which are copied out of the sender and delivered at the start of the receiver's next frame.
+class LuaSchedulerPool
+{
+public:
+	static constexpr int kAnyWorker = -1;
+	static constexpr int kHostSender = -1;	///Sender reported for messages sent from outside the pool
+
+	///Called once per worker with its scheduler, before the first frame, to register further libraries
+	typedef std::function<void (LuaScheduler * scheduler, unsigned int worker)> WorkerSetup;
+	///Called on the worker thread at the start of each of its frames (to drive a per-worker Timer, say)
+	typedef std::function<void (LuaScheduler * scheduler, unsigned int worker)> WorkerFrame;
+
+	LuaSchedulerPool();
+	~LuaSchedulerPool();
+
+	///workerCount 0 uses one worker per hardware thread
+	void Init(unsigned int workerCount = 0, WorkerSetup setup = nullptr, WorkerFrame frame = nullptr);
+	void Deinit();
+
+	///Runs one frame on every worker.  timeBudget is passed through to each LuaScheduler::Update, and also
+	///bounds how long a worker keeps starting queued spawns.
+	void Update(double timeBudget = 0.0);
+
+	///Queues scriptPath to start on the given worker, or on whichever worker gets to it first
+	void Spawn(char const * scriptPath, int worker = kAnyWorker);
+	///Sends a string to the given worker's pool.receive
+	void Send(unsigned int worker, std::string const & text);
+
+	unsigned int GetWorkerCount() const;
+	///Only safe to use between Updates
+	LuaScheduler * GetScheduler(unsigned int worker) const;
+	LuaSchedulerWorkerStats const & GetWorkerStats(unsigned int worker) const;
+	LuaAllocatorStats const & GetAllocatorStats(unsigned int worker) const;
+
+private:
+	void WorkerMain(LuaSchedulerPoolWorker * worker);
+	void QueueSpawn(unsigned int worker, bool pinned, std::string && scriptPath, std::string && arguments);
+	void Post(unsigned int worker, std::string && data, int sender);
+	bool Steal(LuaSchedulerPoolWorker * thief);
+	size_t GetFairShare() const;
+
+	std::vector<std::unique_ptr<LuaSchedulerPoolWorker>>	mWorkers;
+	std::atomic<unsigned int>		mNextWorker {0};	///Round-robin target for unpinned spawns
+
+	std::mutex						mFrameMutex;
+	std::condition_variable			mFrameStart;
+	std::condition_variable			mFrameDone;
+	unsigned long long				mFrame {0};
+	unsigned int					mPendingWorkers {0};
+	double							mFrameBudget {0.0};
+	bool							mQuitting {false};
+	WorkerFrame						mWorkerFrame {nullptr};
+
+	friend class LuaSchedulerPoolWorker;
+};
+
+}
@@ -0,0 +1,204 @@
+#include "Lz4Block.h"
+#include <cstdint>
+#include <cstring>
+
+//Format limits: the last match has to start at least 12 bytes before the end of the input, and the last 5 bytes
+//are always literals, which is what lets decoders copy in whole words near the end
+static const size_t kMinMatch = 4;
+static const size_t kMatchStartLimit = 12;
+static const size_t kLastLiterals = 5;
+static const size_t kMaxOffset = 65535;
+static const int kHashBits = 14;
+
+static inline uint32_t read32(const uint8_t * pointer) {
+	uint32_t value;
+	memcpy(&value, pointer, sizeof(value));
+	return value;
+}
+
+static inline uint32_t hashSequence(uint32_t sequence) {
+	return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+//Lengths past the token's nibble continue in bytes of 255 until one is smaller
+static inline uint8_t * writeLength(uint8_t * output, size_t length) {
+	while (length >= 255) {
+		*output++ = 255;
+		length -= 255;
+	}
+	*output++ = (uint8_t)length;
+	return output;
+}
+
+static inline bool readLength(const uint8_t *& input, const uint8_t * inputEnd, size_t & length) {
+	uint8_t byte;
+	do {
+		if (input >= inputEnd) {
+			return false;
+		}
+		byte = *input++;
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+//Emits literals [anchor, anchor + literalLength) followed by a match, or just the literals when matchLength is 0
+static uint8_t * writeSequence(uint8_t * output, uint8_t * outputEnd, const uint8_t * anchor, size_t literalLength, size_t offset, size_t matchLength) {
+	size_t needed = 1 + literalLength / 255 + 1 + literalLength + (matchLength != 0 ? 2 + (matchLength - kMinMatch) / 255 + 1 : 0);
+	if (needed > (size_t)(outputEnd - output)) {
+		return nullptr;
+	}
+	uint8_t * token = output++;
+	*token = (uint8_t)((literalLength >= 15 ? 15 : literalLength) << 4);
+	if (literalLength >= 15) {
+		output = writeLength(output, literalLength - 15);
+	}
+	if (literalLength != 0) {
+		memcpy(output, anchor, literalLength);
+		output += literalLength;
+	}
+	if (matchLength != 0) {
+		*output++ = (uint8_t)(offset & 0xFF);
+		*output++ = (uint8_t)(offset >> 8);
+		size_t length = matchLength - kMinMatch;
+		*token |= (uint8_t)(length >= 15 ? 15 : length);
+		if (length >= 15) {
+			output = writeLength(output, length - 15);
+		}
+	}
+	return output;
+}
+
+size_t KEngineCore::Lz4BlockBound(size_t sourceSize)
+{
+	return sourceSize + sourceSize / 255 + 16;
+}
+
+size_t KEngineCore::Lz4BlockCompress(const void * source, size_t sourceSize, void * destination, size_t capacity)
+{
+	const uint8_t * input = (const uint8_t *)source;
+	const uint8_t * inputEnd = input + sourceSize;
+	const uint8_t * anchor = input;
+	uint8_t * output = (uint8_t *)destination;
+	uint8_t * outputEnd = output + capacity;
+
+	if (sourceSize > kMatchStartLimit) {
+		const uint8_t * matchStartLimit = inputEnd - kMatchStartLimit;
+		const uint8_t * matchEndLimit = inputEnd - kLastLiterals;
+		//Last position each hashed 4 byte sequence was seen at; stale or colliding entries are caught by comparing
+		uint32_t positions[1 << kHashBits] = {};
+		const uint8_t * cursor = input + 1;
+		while (cursor < matchStartLimit) {
+			uint32_t sequence = read32(cursor);
+			uint32_t & slot = positions[hashSequence(sequence)];
+			const uint8_t * candidate = input + slot;
+			slot = (uint32_t)(cursor - input);
+			if (candidate >= cursor || (size_t)(cursor - candidate) > kMaxOffset || read32(candidate) != sequence) {
+				//Step further the longer nothing has matched, so incompressible data passes through quickly
+				cursor += 1 + ((cursor - anchor) >> 6);
+				continue;
+			}
+			while (cursor > anchor && candidate > input && cursor[-1] == candidate[-1]) {
+				cursor--;
+				candidate--;
+			}
+			const uint8_t * matchEnd = cursor + kMinMatch;
+			const uint8_t * candidateEnd = candidate + kMinMatch;
+			while (matchEnd < matchEndLimit && *matchEnd == *candidateEnd) {
+				matchEnd++;
+				candidateEnd++;
+			}
+			output = writeSequence(output, outputEnd, anchor, (size_t)(cursor - anchor), (size_t)(cursor - candidate), (size_t)(matchEnd - cursor));
+			if (output == nullptr) {
+				return 0;
+			}
+			anchor = matchEnd;
+			cursor = matchEnd;
+			if (cursor < matchStartLimit) {
+				//Remember a position inside the match too; runs of repeats are common
+				positions[hashSequence(read32(cursor - 2))] = (uint32_t)(cursor - 2 - input);
+			}
+		}
+	}
+
+	output = writeSequence(output, outputEnd, anchor, (size_t)(inputEnd - anchor), 0, 0);
+	if (output == nullptr) {
+		return 0;
+	}
+	return (size_t)(output - (uint8_t *)destination);
+}
+
+size_t KEngineCore::Lz4BlockDecompress(const void * source, size_t sourceSize, void * destination, size_t capacity)
+{
+	const uint8_t * input = (const uint8_t *)source;
+	const uint8_t * inputEnd = input + sourceSize;
+	uint8_t * output = (uint8_t *)destination;
+	uint8_t * outputStart = output;
+	uint8_t * outputEnd = output + capacity;
+
+	while (true) {
+		if (input >= inputEnd) {
+			return SIZE_MAX;
+		}
+		uint8_t token = *input++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(input, inputEnd, literalLength)) {
+			return SIZE_MAX;
+		}
+		if (literalLength > (size_t)(inputEnd - input) || literalLength > (size_t)(outputEnd - output)) {
+			return SIZE_MAX;
+		}
+		if (literalLength <= 16 && inputEnd - input >= 16 && outputEnd - output >= 16) {
+			memcpy(output, input, 16);  //Short runs are the common case; one fixed size copy beats a variable one
+		} else {
+			memcpy(output, input, literalLength);
+		}
+		output += literalLength;
+		input += literalLength;
+		if (input == inputEnd) {
+			break;	//The last sequence is literals only
+		}
+
+		if (inputEnd - input < 2) {
+			return SIZE_MAX;
+		}
+		size_t offset = (size_t)input[0] | ((size_t)input[1] << 8);
+		input += 2;
+		if (offset == 0 || offset > (size_t)(output - outputStart)) {
+			return SIZE_MAX;
+		}
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(input, inputEnd, matchLength)) {
+			return SIZE_MAX;
+		}
+		matchLength += kMinMatch;
+		if (matchLength > (size_t)(outputEnd - output)) {
+			return SIZE_MAX;
+		}
+
+		const uint8_t * match = output - offset;
+		uint8_t * matchEnd = output + matchLength;
+		if (offset >= 16 && (size_t)(outputEnd - matchEnd) >= 16) {
+			//Whole chunks at a time, overshooting by up to a chunk less one; chunks can't overlap their source at this distance
+			while (output < matchEnd) {
+				memcpy(output, match, 16);
+				output += 16;
+				match += 16;
+			}
+		} else if (offset >= 8 && (size_t)(outputEnd - matchEnd) >= 8) {
+			while (output < matchEnd) {
+				memcpy(output, match, 8);
+				output += 8;
+				match += 8;
+			}
+		} else {
+			//Short offsets repeat the last few bytes, which has to go a byte at a time
+			while (output < matchEnd) {
+				*output++ = *match++;
+			}
+		}
+		output = matchEnd;
+	}
+	return (size_t)(output - outputStart);
+}
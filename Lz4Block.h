@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+namespace KEngineCore {
+
+///Compression in the LZ4 block format: byte-aligned literal runs and back-references with no entropy coding, so
+///decoding is little more than memcpy.  Output decodes with any LZ4 block decoder and vice versa.
+
+///Largest compressed size for sourceSize bytes, for sizing destination buffers
+size_t Lz4BlockBound(size_t sourceSize);
+
+///Greedy single-pass compressor.  Returns the compressed size, or 0 if capacity is too small.
+size_t Lz4BlockCompress(const void * source, size_t sourceSize, void * destination, size_t capacity);
+
+///Bounds-checked decoder, safe on corrupt or hostile input.  Returns the decoded size, or SIZE_MAX if the input is
+///malformed or would decode past capacity.
+size_t Lz4BlockDecompress(const void * source, size_t sourceSize, void * destination, size_t capacity);
+
+}
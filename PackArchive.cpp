@@ -0,0 +1,148 @@
+#include "PackArchive.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+	std::mutex sMountMutex;
+	std::vector<KEngineCore::PackArchive *> sMounted;
+
+}
+
+KEngineCore::PackArchiveFile::PackArchiveFile()
+{
+}
+
+const char * KEngineCore::PackArchiveFile::GetData() const
+{
+	return mData;
+}
+
+size_t KEngineCore::PackArchiveFile::GetSize() const
+{
+	return mSize;
+}
+
+std::shared_ptr<const void> const & KEngineCore::PackArchiveFile::GetMapping() const
+{
+	return mMapping;
+}
+
+KEngineCore::PackArchiveFile::operator bool() const
+{
+	return mMapping != nullptr;
+}
+
+KEngineCore::PackArchive::PackArchive()
+{
+}
+
+KEngineCore::PackArchive::~PackArchive()
+{
+	Unmount(this);
+	Close();
+}
+
+void KEngineCore::PackArchive::Open(const std::string& path)
+{
+	Close();
+	//The index is read once up front; after that files are picked out of the mapping at random
+	std::shared_ptr<BinaryFile> file = std::make_shared<BinaryFile>();
+	file->LoadFromFile(path, "", BinaryFile::LoadMode::Mapped, BinaryFile::AccessHint::Random);
+
+	size_t archiveSize = file->GetSize();
+	if (archiveSize < sizeof(PackArchiveHeader)) {
+		throw std::runtime_error("not a pack archive!");
+	}
+	const char * base = (const char *)file->GetContents();
+	PackArchiveHeader header;
+	memcpy(&header, base, sizeof(header));
+	if (memcmp(header.mMagic, "KPAK", 4) != 0 || header.mVersion != kVersion ||
+		header.mEntryCount > (archiveSize - sizeof(PackArchiveHeader)) / sizeof(PackArchiveEntry)) {
+		throw std::runtime_error("not a pack archive!");
+	}
+
+	//Under the lock, in case this archive is already mounted and being searched
+	std::lock_guard<std::mutex> lock(sMountMutex);
+	mIndex.Reserve(header.mEntryCount);
+	const char * entries = base + sizeof(PackArchiveHeader);
+	for (uint32_t index = 0; index < header.mEntryCount; index++) {
+		PackArchiveEntry entry;
+		memcpy(&entry, entries + index * sizeof(PackArchiveEntry), sizeof(entry));
+		if (entry.mOffset > archiveSize || entry.mSize > archiveSize - entry.mOffset) {
+			mIndex.Clear();
+			throw std::runtime_error("corrupt pack archive!");
+		}
+		StringHash hash;
+		hash.hash = entry.mHash;
+		mIndex.Insert(hash, Location {base + entry.mOffset, (size_t)entry.mSize, entry.mCheck});
+	}
+	mFile = std::move(file);
+}
+
+void KEngineCore::PackArchive::Close()
+{
+	//Files already handed out keep their own reference, so the mapping goes once the last of them does
+	std::lock_guard<std::mutex> lock(sMountMutex);
+	mIndex.Clear();
+	mFile.reset();
+}
+
+KEngineCore::PackArchiveFile KEngineCore::PackArchive::Find(const std::string& path) const
+{
+	std::lock_guard<std::mutex> lock(sMountMutex);
+	return FindUnlocked(StringHash(path), GetCheckHash(path.data(), path.size()));
+}
+
+size_t KEngineCore::PackArchive::GetEntryCount() const
+{
+	std::lock_guard<std::mutex> lock(sMountMutex);
+	return mIndex.Size();
+}
+
+void KEngineCore::PackArchive::Mount(PackArchive * archive)
+{
+	std::lock_guard<std::mutex> lock(sMountMutex);
+	if (std::find(sMounted.begin(), sMounted.end(), archive) == sMounted.end()) {
+		sMounted.push_back(archive);
+	}
+}
+
+void KEngineCore::PackArchive::Unmount(PackArchive * archive)
+{
+	std::lock_guard<std::mutex> lock(sMountMutex);
+	sMounted.erase(std::remove(sMounted.begin(), sMounted.end(), archive), sMounted.end());
+}
+
+KEngineCore::PackArchiveFile KEngineCore::PackArchive::FindMounted(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(sMountMutex);
+	if (sMounted.empty()) {
+		return PackArchiveFile();
+	}
+	StringHash hash(path);
+	uint32_t check = GetCheckHash(path.data(), path.size());
+	for (auto it = sMounted.rbegin(); it != sMounted.rend(); it++) {
+		PackArchiveFile file = (*it)->FindUnlocked(hash, check);
+		if (file) {
+			return file;
+		}
+	}
+	return PackArchiveFile();
+}
+
+KEngineCore::PackArchiveFile KEngineCore::PackArchive::FindUnlocked(StringHash hash, uint32_t check) const
+{
+	PackArchiveFile file;
+	const Location * location = mIndex.Find(hash);
+	if (location == nullptr || location->mCheck != check) {
+		return file;  //Not here, or a different path with the same StringHash
+	}
+	file.mMapping = mFile;
+	file.mData = location->mData;
+	file.mSize = location->mSize;
+	return file;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "BinaryFile.h"
+#include "StringHash.h"
+#include "StringHashMap.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace KEngineCore {
+
+///On-disk layout, all little endian: a header, the index sorted by hash, then each file's bytes at a 16 byte aligned offset
+struct PackArchiveHeader {
+	char		mMagic[4];		///"KPAK"
+	uint32_t	mVersion;
+	uint32_t	mEntryCount;
+	uint32_t	mReserved;
+};
+
+struct PackArchiveEntry {
+	uint32_t	mHash;			///StringHash of the path, exactly as it's passed to TextFile/BinaryFile (filename + extension)
+	uint32_t	mCheck;			///PackArchive::GetCheckHash of the path, so a path that merely shares mHash isn't served this file
+	uint64_t	mOffset;		///From the start of the archive
+	uint64_t	mSize;
+};
+
+///A file found in a mounted archive.  It holds a reference to the archive's mapping, so the data stays valid for as
+///long as this does, even if the archive is unmounted and closed meanwhile.
+class PackArchiveFile
+{
+public:
+	PackArchiveFile();
+
+	const char * GetData() const;
+	size_t GetSize() const;
+	///The mapping this points into, for holding on to it after this is gone
+	std::shared_ptr<const void> const & GetMapping() const;
+	explicit operator bool() const;
+
+private:
+	std::shared_ptr<const void>	mMapping;
+	const char *				mData {nullptr};
+	size_t						mSize {0};
+	friend class PackArchive;
+};
+
+///Many files packed into one, built by Tools/PackBuilder, so startup pays for one open and one mapping instead of an
+///open and a read per file.  The archive is mapped once and files are served straight out of the mapping.
+///
+///Mounted archives are consulted by TextFile, BinaryFile and FileLoader before the file system, so game code loads
+///packed files exactly as it loads loose ones.  The most recently mounted archive wins, which lets a patch archive
+///override a base one.  Lookups are safe from any thread, alongside Mount, Unmount and Close on another.
+class PackArchive
+{
+public:
+	static constexpr uint32_t kVersion = 2;
+
+	PackArchive();
+	~PackArchive();
+	PackArchive(const PackArchive&) = delete;
+	PackArchive& operator=(const PackArchive&) = delete;
+
+	///Throws std::runtime_error if the file can't be mapped or isn't a valid archive
+	void Open(const std::string& path);
+	void Close();
+
+	PackArchiveFile Find(const std::string& path) const;
+	size_t GetEntryCount() const;
+
+	static void Mount(PackArchive * archive);
+	static void Unmount(PackArchive * archive);
+	///Looks path up in every mounted archive, newest first
+	static PackArchiveFile FindMounted(const std::string& path);
+
+	///FNV-1a, a second hash independent of StringHash's CRC, checked on lookup
+	static constexpr uint32_t GetCheckHash(char const * data, size_t length)
+	{
+		uint32_t hash = 2166136261u;
+		for (size_t index = 0; index < length; index++) {
+			hash = (hash ^ (unsigned char)data[index]) * 16777619u;
+		}
+		return hash;
+	}
+
+private:
+	struct Location {
+		const char *	mData;
+		size_t			mSize;
+		uint32_t		mCheck;
+	};
+
+	PackArchiveFile FindUnlocked(StringHash hash, uint32_t check) const;
+
+	std::shared_ptr<BinaryFile>	mFile;		///Shared with every PackArchiveFile handed out, so Close never pulls pages from under a reader
+	StringHashMap<Location>		mIndex;
+};
+
+}
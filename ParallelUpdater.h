@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Updater.h"
+#include "WorkerPool.h"
+#include <mutex>
+
+
+namespace KEngineCore {
+
+	///------------------------------------------------------------------------
+	///------------------------------------------------------------------------
+
+	///Updater whose pass is spread across a WorkerPool, for TClass types whose updates don't depend on one another.
+	///Update still returns only once every object has been updated.
+	///
+	///Updates run concurrently, so during a pass an object may Start anything and may Stop itself, but must not Stop
+	///other objects of the same updater (another thread may be about to update them).
+	template <class TClass>
+	class ParallelUpdater : public Updater<TClass>
+	{
+	public:
+		ParallelUpdater();
+		~ParallelUpdater();
+
+		void Init(WorkerPool * workerPool, size_t minChunkSize = 64);
+		void Deinit();
+
+		void Update(double fTime);
+
+		///Smallest run of objects handed to one thread; raise it for cheap updates, lower it for expensive ones
+		void SetMinChunkSize(size_t minChunkSize);
+
+	private:
+		WorkerPool *	mWorkerPool {nullptr};
+		size_t			mMinChunkSize {64};
+		std::mutex		mMutex;
+	};
+
+	///------------------------------------------------------------------------
+
+	template <class TClass>
+	ParallelUpdater<TClass>::ParallelUpdater()
+	{
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TClass>
+	ParallelUpdater<TClass>::~ParallelUpdater()
+	{
+		Deinit();
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TClass>
+	void ParallelUpdater<TClass>::Init(WorkerPool * workerPool, size_t minChunkSize)
+	{
+		assert(workerPool != nullptr);
+		Updater<TClass>::Init();
+		mWorkerPool = workerPool;
+		mMinChunkSize = minChunkSize;
+		this->mPassMutex = &mMutex;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TClass>
+	void ParallelUpdater<TClass>::Deinit()
+	{
+		Updater<TClass>::Deinit();
+		mWorkerPool = nullptr;
+		this->mPassMutex = nullptr;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TClass>
+	void ParallelUpdater<TClass>::Update(double fTime)
+	{
+		///Each due lane is spread across the pool in turn, so phases and priorities still run in order
+		this->RunUpdatePass(fTime, [this] (typename Updater<TClass>::Lane & lane, double laneTime)
+			{
+				Updating<TClass> * const * updateList = lane.data();  ///Can't reallocate mid-pass; additions are deferred
+				mWorkerPool->ParallelFor(lane.size(), mMinChunkSize, [updateList, laneTime] (size_t begin, size_t end)
+					{
+						for (size_t index = begin; index < end; index++)
+						{
+							Updating<TClass> * updateable = updateList[index];
+							if (updateable != nullptr)	///Stopped earlier in this pass
+							{
+								updateable->UpdateFromLane(laneTime);
+							}
+						}
+					});
+			});
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TClass>
+	void ParallelUpdater<TClass>::SetMinChunkSize(size_t minChunkSize)
+	{
+		mMinChunkSize = minChunkSize;
+	}
+
+	///------------------------------------------------------------------------
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "StringHash.h"
+#include <cstddef>
+#include <cstdint>
+
+
+namespace KEngineCore {
+
+	///------------------------------------------------------------------------
+	///------------------------------------------------------------------------
+
+	///Where a key lands, shared by PerfectHashTable and the generator, which must place keys exactly as lookups find them
+	struct PerfectHashFunction
+	{
+		static constexpr uint32_t Mix(uint32_t hash, uint32_t seed)
+		{
+			///murmur3's finalizer; the CRC alone is too linear to spread keys that differ by a character or two
+			uint32_t mixed = hash ^ (seed * 0x9E3779B9u);
+			mixed ^= mixed >> 16;
+			mixed *= 0x85EBCA6Bu;
+			mixed ^= mixed >> 13;
+			mixed *= 0xC2B2AE35u;
+			mixed ^= mixed >> 16;
+			return mixed;
+		}
+
+		///Scales the mix into 0..range-1 with a multiply instead of a divide
+		static constexpr size_t Reduce(uint32_t mixed, size_t range)
+		{
+			return (size_t)(((uint64_t)mixed * range) >> 32);
+		}
+
+		static constexpr size_t GetBucket(uint32_t hash, size_t bucketCount)
+		{
+			return Reduce(Mix(hash, 0), bucketCount);
+		}
+
+		static constexpr size_t GetSlot(uint32_t hash, uint32_t seed, size_t keyCount)
+		{
+			return Reduce(Mix(hash, seed + 1), keyCount);
+		}
+	};
+
+	///------------------------------------------------------------------------
+
+	///Minimal perfect hash over a closed set of StringHash keys, as emitted by Tools/PerfectHashGenerator from a name list.
+	///Every key maps to its own slot in 0..kKeyCount-1: the key's bucket picks a seed, the seed picks the slot, and one
+	///compare against the stored key tells a member from a stranger.  No chains and no probing.
+	///
+	///Find returns the slot, so per-name data lives in plain arrays indexed by it.  Everything is constexpr, so
+	///lookups of "name"_hash constants fold away entirely wherever they're constant expressions.
+	template <size_t kKeyCount, size_t kBucketCount>
+	struct PerfectHashTable
+	{
+		static constexpr size_t kNotFound = SIZE_MAX;
+
+		uint32_t	mSeeds[kBucketCount];
+		uint32_t	mKeys[kKeyCount];	///In slot order
+
+		constexpr size_t Find(StringHash key) const
+		{
+			uint32_t hash = key.hash;
+			size_t slot = PerfectHashFunction::GetSlot(hash, mSeeds[PerfectHashFunction::GetBucket(hash, kBucketCount)], kKeyCount);
+			return mKeys[slot] == hash ? slot : kNotFound;
+		}
+
+		constexpr bool Contains(StringHash key) const
+		{
+			return Find(key) != kNotFound;
+		}
+
+		constexpr size_t Size() const
+		{
+			return kKeyCount;
+		}
+	};
+
+	///------------------------------------------------------------------------
+}
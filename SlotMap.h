@@ -0,0 +1,270 @@
+#pragma once
+
+#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+
+namespace KEngineCore {
+
+	///------------------------------------------------------------------------
+	///------------------------------------------------------------------------
+
+	///Stable reference to a SlotMap entry.  Goes stale (rather than dangling) once the entry is erased.
+	struct SlotMapHandle
+	{
+		uint32_t	mIndex {UINT32_MAX};
+		uint32_t	mGeneration {0};
+
+		bool IsNull() const { return mIndex == UINT32_MAX; }
+		bool operator==(SlotMapHandle const & other) const { return mIndex == other.mIndex && mGeneration == other.mGeneration; }
+		bool operator!=(SlotMapHandle const & other) const { return !(*this == other); }
+	};
+
+	///------------------------------------------------------------------------
+	///------------------------------------------------------------------------
+
+	///Values are kept densely packed so iteration is a linear scan; insert, erase and lookup are O(1).
+	///Erasing moves the last value into the hole, so dense order is not stable.
+	template <class TValue>
+	class SlotMap
+	{
+	public:
+		SlotMap();
+		~SlotMap();
+
+		template <class... TArgs>
+		SlotMapHandle Emplace(TArgs &&... args);
+		SlotMapHandle Insert(TValue const & value);
+		bool Erase(SlotMapHandle handle);
+		void Clear();
+		void Reserve(size_t capacity);
+
+		bool Contains(SlotMapHandle handle) const;
+		TValue * Get(SlotMapHandle handle);
+		TValue const * Get(SlotMapHandle handle) const;
+
+		///Dense access, valid for indices below Size()
+		size_t Size() const;
+		bool Empty() const;
+		TValue * Data();
+		TValue const * Data() const;
+		TValue & operator[](size_t denseIndex);
+		TValue const & operator[](size_t denseIndex) const;
+		SlotMapHandle GetHandle(size_t denseIndex) const;
+
+		typename std::vector<TValue>::iterator begin() { return mValues.begin(); }
+		typename std::vector<TValue>::iterator end() { return mValues.end(); }
+		typename std::vector<TValue>::const_iterator begin() const { return mValues.begin(); }
+		typename std::vector<TValue>::const_iterator end() const { return mValues.end(); }
+
+	private:
+		struct Slot
+		{
+			uint32_t	mDenseIndex {0};	///Next free slot while the slot is unused
+			uint32_t	mGeneration {0};
+		};
+
+		SlotMapHandle AllocateSlot();
+
+		std::vector<TValue>		mValues;
+		std::vector<uint32_t>	mValueSlots;	///Slot index for each dense value
+		std::vector<Slot>		mSlots;
+		uint32_t				mFreeSlot {UINT32_MAX};
+	};
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	SlotMap<TValue>::SlotMap()
+	{
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	SlotMap<TValue>::~SlotMap()
+	{
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	template <class... TArgs>
+	SlotMapHandle SlotMap<TValue>::Emplace(TArgs &&... args)
+	{
+		SlotMapHandle handle = AllocateSlot();
+		mValues.emplace_back(std::forward<TArgs>(args)...);
+		mValueSlots.push_back(handle.mIndex);
+		return handle;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	SlotMapHandle SlotMap<TValue>::Insert(TValue const & value)
+	{
+		return Emplace(value);
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	bool SlotMap<TValue>::Erase(SlotMapHandle handle)
+	{
+		if (!Contains(handle))
+		{
+			return false;
+		}
+		Slot & slot = mSlots[handle.mIndex];
+		uint32_t denseIndex = slot.mDenseIndex;
+		uint32_t lastIndex = (uint32_t)mValues.size() - 1;
+		if (denseIndex != lastIndex)
+		{
+			mValues[denseIndex] = std::move(mValues[lastIndex]);
+			mValueSlots[denseIndex] = mValueSlots[lastIndex];
+			mSlots[mValueSlots[denseIndex]].mDenseIndex = denseIndex;
+		}
+		mValues.pop_back();
+		mValueSlots.pop_back();
+
+		slot.mGeneration++;	///Invalidate outstanding handles
+		slot.mDenseIndex = mFreeSlot;
+		mFreeSlot = handle.mIndex;
+		return true;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	void SlotMap<TValue>::Clear()
+	{
+		while (!mValues.empty())
+		{
+			Erase(GetHandle(mValues.size() - 1));
+		}
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	void SlotMap<TValue>::Reserve(size_t capacity)
+	{
+		mValues.reserve(capacity);
+		mValueSlots.reserve(capacity);
+		mSlots.reserve(capacity);
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	bool SlotMap<TValue>::Contains(SlotMapHandle handle) const
+	{
+		///Erasing bumps the slot's generation, so a free or reused slot never matches an old handle
+		return handle.mIndex < mSlots.size() && mSlots[handle.mIndex].mGeneration == handle.mGeneration;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	TValue * SlotMap<TValue>::Get(SlotMapHandle handle)
+	{
+		return Contains(handle) ? &mValues[mSlots[handle.mIndex].mDenseIndex] : nullptr;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	TValue const * SlotMap<TValue>::Get(SlotMapHandle handle) const
+	{
+		return Contains(handle) ? &mValues[mSlots[handle.mIndex].mDenseIndex] : nullptr;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	size_t SlotMap<TValue>::Size() const
+	{
+		return mValues.size();
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	bool SlotMap<TValue>::Empty() const
+	{
+		return mValues.empty();
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	TValue * SlotMap<TValue>::Data()
+	{
+		return mValues.data();
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	TValue const * SlotMap<TValue>::Data() const
+	{
+		return mValues.data();
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	TValue & SlotMap<TValue>::operator[](size_t denseIndex)
+	{
+		assert(denseIndex < mValues.size());
+		return mValues[denseIndex];
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	TValue const & SlotMap<TValue>::operator[](size_t denseIndex) const
+	{
+		assert(denseIndex < mValues.size());
+		return mValues[denseIndex];
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	SlotMapHandle SlotMap<TValue>::GetHandle(size_t denseIndex) const
+	{
+		assert(denseIndex < mValues.size());
+		SlotMapHandle handle;
+		handle.mIndex = mValueSlots[denseIndex];
+		handle.mGeneration = mSlots[handle.mIndex].mGeneration;
+		return handle;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	SlotMapHandle SlotMap<TValue>::AllocateSlot()
+	{
+		SlotMapHandle handle;
+		if (mFreeSlot != UINT32_MAX)
+		{
+			handle.mIndex = mFreeSlot;
+			mFreeSlot = mSlots[mFreeSlot].mDenseIndex;
+		}
+		else
+		{
+			handle.mIndex = (uint32_t)mSlots.size();
+			mSlots.emplace_back();
+		}
+		Slot & slot = mSlots[handle.mIndex];
+		slot.mDenseIndex = (uint32_t)mValues.size();
+		handle.mGeneration = slot.mGeneration;
+		return handle;
+	}
+
+	///------------------------------------------------------------------------
+}
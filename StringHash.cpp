@@ -1,44 +1,41 @@
 #include "StringHash.h"
-#include <assert.h>
-#include <string>
-#include "boost/crc.hpp"
+#include "Crc32.h"
+#include "StringHashRegistry.h"
+#include <cstring>
 
 
-KEngineCore::StringHash::StringHash()
-{
+KEngineCore::StringHash::StringHash(char const * inString)
+{	
+	size_t length = strlen(inString);
 #ifndef NDEBUG
-	string = nullptr;
+	string = inString;
 #endif
-	hash = 0;
-}
-
-
-KEngineCore::StringHash::StringHash(StringHash const & other)
-{
+	hash = Crc32Fast(inString, length);
 #ifndef NDEBUG
-	string = other.string;
+	if (StringHashRegistry::IsEnabled()) {
+		StringHashRegistry::Record(*this, std::string_view(inString, length));
+	}
 #endif
-	hash = other.hash;
 }
 
-
-KEngineCore::StringHash::StringHash(char const * inString, unsigned int inHash)
+KEngineCore::StringHash::StringHash(std::string const & inString)
 {
+	hash = Crc32Fast(inString.data(), inString.size());
 #ifndef NDEBUG
-	boost::crc_32_type crcCalculator;
-	crcCalculator.process_bytes(inString, strlen(inString));
-	assert(crcCalculator.checksum() == inHash);
-	string = inString;
+	if (StringHashRegistry::IsEnabled()) {
+		string = StringHashRegistry::Intern(inString);  //inString is often a temporary
+		StringHashRegistry::Record(*this, inString);
+	}
 #endif
-	hash = inHash;
 }
 
-KEngineCore::StringHash::StringHash(char const * inString)
-{	
+KEngineCore::StringHash::StringHash(std::string_view inString)
+{
+	hash = Crc32Fast(inString.data(), inString.size());
 #ifndef NDEBUG
-	string = inString;
+	if (StringHashRegistry::IsEnabled()) {
+		string = StringHashRegistry::Intern(inString);
+		StringHashRegistry::Record(*this, inString);
+	}
 #endif
-	boost::crc_32_type crcCalculator;
-	crcCalculator.process_bytes(inString, strlen(inString));
-	hash = crcCalculator.checksum();
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -1,20 +1,57 @@
 #pragma once
 #include <functional>
+#include <string>
+#include <string_view>
+#include <cassert>
+#include "Crc32.h"
 
 namespace KEngineCore {
 struct StringHash
 {
-	StringHash();
-	StringHash(StringHash const & other);
-	StringHash(char const * string, unsigned int hash);
+	constexpr StringHash() {}
+	constexpr StringHash(StringHash const & other) = default;
+	constexpr StringHash & operator=(StringHash const & other) = default;
+	///Checked against the string in debug builds, at compile time when used in a constant expression
+	constexpr StringHash(char const * inString, unsigned int inHash)
+		: hash(inHash)
+#ifndef NDEBUG
+		, string(inString)
+#endif
+	{
+#ifndef NDEBUG
+		assert(inString == nullptr || Crc32(inString) == inHash);
+#else
+		(void)inString;
+#endif
+	}
+	///Keeps the pointer as the debug string, so string has to outlive the hash
 	StringHash(char const * string);
+	///With the registry enabled these two keep an interned copy as the debug string; otherwise it stays null
+	StringHash(std::string const & string);
+	///Hashes exactly the given characters, so no strlen
+	StringHash(std::string_view string);
     unsigned int hash {0};
 #ifndef NDEBUG
     char const * string {nullptr};
 #endif
-	inline operator unsigned int(void) const { return hash; }
+	constexpr operator unsigned int(void) const { return hash; }
 };
 
+///"name"_hash is a StringHash of the literal, usable anywhere a HASH constant was.  It's guaranteed to be computed at
+///compile time only where a constant is required (a case label, template argument, or constexpr variable); elsewhere
+///an optimizing build folds it, but an unoptimized one may hash at runtime.  For hot paths in debug builds, bind it to a
+///constexpr first:  static constexpr StringHash kName = "name"_hash;
+constexpr StringHash operator"" _hash(char const * string, size_t length)
+{
+	///Built from the hash just computed, so the debug check in the (string, hash) constructor would only repeat it
+	StringHash result;
+	result.hash = Crc32(string, length);
+#ifndef NDEBUG
+	result.string = string;
+#endif
+	return result;
+}
+
 }
 #ifndef NDEBUG
 #define HASH(string, hash) (KEngineCore::StringHash(string, hash))
@@ -0,0 +1,40 @@
+#include "StringHash64.h"
+#include "StringHashRegistry.h"
+#include <cstring>
+
+
+KEngineCore::StringHash64::StringHash64(char const * inString)
+{
+	size_t length = strlen(inString);
+#ifndef NDEBUG
+	string = inString;
+#endif
+	hash = Crc64Fast(inString, length);
+#ifndef NDEBUG
+	if (StringHashRegistry::IsEnabled()) {
+		StringHashRegistry::Record(*this, std::string_view(inString, length));
+	}
+#endif
+}
+
+KEngineCore::StringHash64::StringHash64(std::string const & inString)
+{
+	hash = Crc64Fast(inString.data(), inString.size());
+#ifndef NDEBUG
+	if (StringHashRegistry::IsEnabled()) {
+		string = StringHashRegistry::Intern(inString);  //inString is often a temporary
+		StringHashRegistry::Record(*this, inString);
+	}
+#endif
+}
+
+KEngineCore::StringHash64::StringHash64(std::string_view inString)
+{
+	hash = Crc64Fast(inString.data(), inString.size());
+#ifndef NDEBUG
+	if (StringHashRegistry::IsEnabled()) {
+		string = StringHashRegistry::Intern(inString);
+		StringHashRegistry::Record(*this, inString);
+	}
+#endif
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <string_view>
+#include <cassert>
+#include <cstdint>
+#include "Crc64.h"
+
+namespace KEngineCore {
+
+///StringHash with a 64 bit CRC, for large tables keyed by hash alone where 32 bits would make collisions likely.
+///Same API as StringHash: HASH64 and "name"_hash64 for constants, and runtime constructors from strings.
+struct StringHash64
+{
+	constexpr StringHash64() {}
+	constexpr StringHash64(StringHash64 const & other) = default;
+	constexpr StringHash64 & operator=(StringHash64 const & other) = default;
+	///Checked against the string in debug builds, at compile time when used in a constant expression
+	constexpr StringHash64(char const * inString, uint64_t inHash)
+		: hash(inHash)
+#ifndef NDEBUG
+		, string(inString)
+#endif
+	{
+#ifndef NDEBUG
+		assert(inString == nullptr || Crc64(inString) == inHash);
+#else
+		(void)inString;
+#endif
+	}
+	///Keeps the pointer as the debug string, so string has to outlive the hash
+	StringHash64(char const * string);
+	///With the registry enabled these two keep an interned copy as the debug string; otherwise it stays null
+	StringHash64(std::string const & string);
+	///Hashes exactly the given characters, so no strlen
+	StringHash64(std::string_view string);
+	uint64_t hash {0};
+#ifndef NDEBUG
+	char const * string {nullptr};
+#endif
+	constexpr operator uint64_t(void) const { return hash; }
+};
+
+///As "name"_hash: only guaranteed to be computed at compile time where a constant is required
+constexpr StringHash64 operator"" _hash64(char const * string, size_t length)
+{
+	StringHash64 result;
+	result.hash = Crc64(string, length);
+#ifndef NDEBUG
+	result.string = string;
+#endif
+	return result;
+}
+
+}
+#ifndef NDEBUG
+#define HASH64(string, hash) (KEngineCore::StringHash64(string, hash))
+#else
+#define HASH64(string, hash) (KEngineCore::StringHash64(nullptr, hash))
+#endif
+
+namespace std
+{
+	template <>
+	struct hash<KEngineCore::StringHash64>
+	{
+		size_t operator()(const KEngineCore::StringHash64& s) const
+		{
+			return (size_t)s.hash;
+		}
+	};
+}
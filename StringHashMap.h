@@ -0,0 +1,323 @@
+#pragma once
+
+#include "StringHash.h"
+#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+
+namespace KEngineCore {
+
+	///------------------------------------------------------------------------
+	///------------------------------------------------------------------------
+
+	///Map keyed by StringHash, for use in place of std::unordered_map<StringHash, TValue>.
+	///
+	///The CRC in the key is already well mixed, so it's used directly as the table position and never recomputed, even
+	///when growing.  The table is open addressed with Robin Hood linear probing, and holds just the hash and the
+	///index of the entry, so a probe walks 8 byte slots however big TValue is.  Entries are kept densely packed like
+	///SlotMap's, so iteration is a linear scan; erasing moves the last entry into the hole, so order is not stable.
+	///Erase shifts the following slots back rather than leaving tombstones, so heavy churn doesn't degrade lookups.
+	///
+	///Like the unordered_map it replaces, keys are compared by hash alone: two strings with the same CRC are one key.
+	template <class TValue>
+	class StringHashMap
+	{
+	public:
+		struct Entry
+		{
+			unsigned int	mKey;
+			TValue			mValue;
+		};
+
+		StringHashMap();
+		~StringHashMap();
+
+		///Returns the entry's value and whether it was added; an existing value is left as it was
+		template <class... TArgs>
+		std::pair<TValue *, bool> Emplace(StringHash key, TArgs &&... args);
+		std::pair<TValue *, bool> Insert(StringHash key, TValue const & value);
+		///Default constructs the value if the key isn't present
+		TValue & operator[](StringHash key);
+		bool Erase(StringHash key);
+		void Clear();
+		///Sizes the table so that count entries fit without growing
+		void Reserve(size_t count);
+
+		bool Contains(StringHash key) const;
+		TValue * Find(StringHash key);
+		TValue const * Find(StringHash key) const;
+
+		size_t Size() const;
+		bool Empty() const;
+
+		typename std::vector<Entry>::iterator begin() { return mEntries.begin(); }
+		typename std::vector<Entry>::iterator end() { return mEntries.end(); }
+		typename std::vector<Entry>::const_iterator begin() const { return mEntries.begin(); }
+		typename std::vector<Entry>::const_iterator end() const { return mEntries.end(); }
+
+	private:
+		struct Slot
+		{
+			uint32_t	mHash {0};
+			uint32_t	mEntry {kEmpty};
+		};
+
+		static const uint32_t kEmpty = UINT32_MAX;
+		static const size_t kMinSlots = 16;
+
+		///Slot index holding hash, or SIZE_MAX
+		size_t FindSlot(uint32_t hash) const;
+		///Distance of the slot at index from where its hash would ideally sit
+		size_t GetProbeDistance(size_t index) const;
+		void PlaceSlot(Slot slot);
+		void Grow(size_t slotCount);
+
+		std::vector<Entry>	mEntries;
+		std::vector<Slot>	mSlots;
+		size_t				mMask {0};
+	};
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	StringHashMap<TValue>::StringHashMap()
+	{
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	StringHashMap<TValue>::~StringHashMap()
+	{
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	template <class... TArgs>
+	std::pair<TValue *, bool> StringHashMap<TValue>::Emplace(StringHash key, TArgs &&... args)
+	{
+		uint32_t hash = key.hash;
+		size_t index = FindSlot(hash);
+		if (index != SIZE_MAX)
+		{
+			return std::pair<TValue *, bool>(&mEntries[mSlots[index].mEntry].mValue, false);
+		}
+		///Grow past 80% full; Robin Hood keeps probes short well beyond that, but lookups of absent keys suffer
+		if ((mEntries.size() + 1) * 5 > mSlots.size() * 4)
+		{
+			Grow(mSlots.empty() ? kMinSlots : mSlots.size() * 2);
+		}
+		Slot slot;
+		slot.mHash = hash;
+		slot.mEntry = (uint32_t)mEntries.size();
+		mEntries.push_back(Entry {key.hash, TValue(std::forward<TArgs>(args)...)});
+		PlaceSlot(slot);
+		return std::pair<TValue *, bool>(&mEntries.back().mValue, true);
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	std::pair<TValue *, bool> StringHashMap<TValue>::Insert(StringHash key, TValue const & value)
+	{
+		return Emplace(key, value);
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	TValue & StringHashMap<TValue>::operator[](StringHash key)
+	{
+		return *Emplace(key).first;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	bool StringHashMap<TValue>::Erase(StringHash key)
+	{
+		size_t index = FindSlot(key.hash);
+		if (index == SIZE_MAX)
+		{
+			return false;
+		}
+		uint32_t entryIndex = mSlots[index].mEntry;
+
+		///Backward shift: pull each following displaced slot one step closer to home until one is already there
+		size_t next = (index + 1) & mMask;
+		while (mSlots[next].mEntry != kEmpty && GetProbeDistance(next) != 0)
+		{
+			mSlots[index] = mSlots[next];
+			index = next;
+			next = (next + 1) & mMask;
+		}
+		mSlots[index] = Slot();
+
+		uint32_t lastIndex = (uint32_t)mEntries.size() - 1;
+		if (entryIndex != lastIndex)
+		{
+			mEntries[entryIndex] = std::move(mEntries[lastIndex]);
+			mSlots[FindSlot(mEntries[entryIndex].mKey)].mEntry = entryIndex;
+		}
+		mEntries.pop_back();
+		return true;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	void StringHashMap<TValue>::Clear()
+	{
+		mEntries.clear();
+		for (Slot & slot : mSlots)
+		{
+			slot = Slot();
+		}
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	void StringHashMap<TValue>::Reserve(size_t count)
+	{
+		mEntries.reserve(count);
+		size_t slotCount = kMinSlots;
+		while (count * 5 > slotCount * 4)
+		{
+			slotCount *= 2;
+		}
+		if (slotCount > mSlots.size())
+		{
+			Grow(slotCount);
+		}
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	bool StringHashMap<TValue>::Contains(StringHash key) const
+	{
+		return FindSlot(key.hash) != SIZE_MAX;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	TValue * StringHashMap<TValue>::Find(StringHash key)
+	{
+		size_t index = FindSlot(key.hash);
+		return index != SIZE_MAX ? &mEntries[mSlots[index].mEntry].mValue : nullptr;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	TValue const * StringHashMap<TValue>::Find(StringHash key) const
+	{
+		size_t index = FindSlot(key.hash);
+		return index != SIZE_MAX ? &mEntries[mSlots[index].mEntry].mValue : nullptr;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	size_t StringHashMap<TValue>::Size() const
+	{
+		return mEntries.size();
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	bool StringHashMap<TValue>::Empty() const
+	{
+		return mEntries.empty();
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	size_t StringHashMap<TValue>::FindSlot(uint32_t hash) const
+	{
+		if (mSlots.empty())
+		{
+			return SIZE_MAX;
+		}
+		size_t index = hash & mMask;
+		for (size_t distance = 0; ; distance++)
+		{
+			Slot const & slot = mSlots[index];
+			if (slot.mEntry == kEmpty)
+			{
+				return SIZE_MAX;
+			}
+			if (slot.mHash == hash)
+			{
+				return index;
+			}
+			///Robin Hood order: had hash been here, it would have displaced this closer-to-home slot
+			if (GetProbeDistance(index) < distance)
+			{
+				return SIZE_MAX;
+			}
+			index = (index + 1) & mMask;
+		}
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	size_t StringHashMap<TValue>::GetProbeDistance(size_t index) const
+	{
+		return (index - (mSlots[index].mHash & mMask)) & mMask;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	void StringHashMap<TValue>::PlaceSlot(Slot slot)
+	{
+		size_t index = slot.mHash & mMask;
+		for (size_t distance = 0; ; distance++)
+		{
+			if (mSlots[index].mEntry == kEmpty)
+			{
+				mSlots[index] = slot;
+				return;
+			}
+			///Take from the rich: whichever slot is closer to home moves on
+			size_t existingDistance = GetProbeDistance(index);
+			if (existingDistance < distance)
+			{
+				std::swap(slot, mSlots[index]);
+				distance = existingDistance;
+			}
+			index = (index + 1) & mMask;
+		}
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TValue>
+	void StringHashMap<TValue>::Grow(size_t slotCount)
+	{
+		assert((slotCount & (slotCount - 1)) == 0);	///Power of two, so the mask works
+		std::vector<Slot> oldSlots;
+		oldSlots.swap(mSlots);
+		mSlots.resize(slotCount);
+		mMask = slotCount - 1;
+		for (Slot const & slot : oldSlots)
+		{
+			if (slot.mEntry != kEmpty)
+			{
+				PlaceSlot(slot);
+			}
+		}
+	}
+
+	///------------------------------------------------------------------------
+}
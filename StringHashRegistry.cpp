@@ -0,0 +1,87 @@
+#include "StringHashRegistry.h"
+#include "StringHash.h"
+#include "StringHash64.h"
+#include <assert.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+	std::atomic<bool> sEnabled {false};
+	std::mutex sMutex;
+	KEngineCore::StringHashRegistry::CollisionHandler sHandler {nullptr};
+	std::unordered_map<uint32_t, std::string> sStrings32;
+	std::unordered_map<uint64_t, std::string> sStrings64;
+	std::unordered_set<std::string> sInterned;	//Never cleared, so what Intern hands out stays valid
+
+	void reportCollision(char const * existing, char const * incoming, uint64_t hash, int bits) {
+		fprintf(stderr, "StringHash collision: \"%s\" and \"%s\" both hash to %0*llx (%d bit)\n", existing, incoming, bits / 4, (unsigned long long)hash, bits);
+		assert(false);
+	}
+
+	template <class TKey>
+	void record(std::unordered_map<TKey, std::string> & strings, TKey hash, std::string_view string, int bits) {
+		std::string existing;
+		KEngineCore::StringHashRegistry::CollisionHandler handler;
+		{
+			std::lock_guard<std::mutex> lock(sMutex);
+			auto inserted = strings.emplace(hash, string);
+			if (inserted.second || inserted.first->second == string) {
+				return;
+			}
+			existing = inserted.first->second;
+			handler = sHandler != nullptr ? sHandler : reportCollision;
+		}
+		//Outside the lock, so a handler is free to hash strings itself
+		std::string incoming(string);
+		handler(existing.c_str(), incoming.c_str(), hash, bits);
+	}
+
+}
+
+void KEngineCore::StringHashRegistry::Enable(CollisionHandler handler)
+{
+	std::lock_guard<std::mutex> lock(sMutex);
+	sHandler = handler;
+	sEnabled = true;
+}
+
+void KEngineCore::StringHashRegistry::Disable()
+{
+	std::lock_guard<std::mutex> lock(sMutex);
+	sEnabled = false;
+	sHandler = nullptr;
+	sStrings32.clear();
+	sStrings64.clear();
+}
+
+bool KEngineCore::StringHashRegistry::IsEnabled()
+{
+	return sEnabled.load(std::memory_order_relaxed);
+}
+
+void KEngineCore::StringHashRegistry::Record(StringHash hash, std::string_view string)
+{
+	record<uint32_t>(sStrings32, hash.hash, string, 32);
+}
+
+void KEngineCore::StringHashRegistry::Record(StringHash64 hash, std::string_view string)
+{
+	record<uint64_t>(sStrings64, hash.hash, string, 64);
+}
+
+size_t KEngineCore::StringHashRegistry::GetCount()
+{
+	std::lock_guard<std::mutex> lock(sMutex);
+	return sStrings32.size() + sStrings64.size();
+}
+
+char const * KEngineCore::StringHashRegistry::Intern(std::string_view string)
+{
+	std::lock_guard<std::mutex> lock(sMutex);
+	return sInterned.emplace(string).first->c_str();
+}
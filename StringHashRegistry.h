@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+namespace KEngineCore {
+
+struct StringHash;
+struct StringHash64;
+
+///Debug aid: remembers the string behind every hash built at runtime and reports two different strings with the same
+///hash the moment the second is hashed, rather than letting them alias silently.  Off until Enable, and never fed in
+///NDEBUG builds.  The 32 and 64 bit hashes are tracked separately.
+///
+///Literal constants ("name"_hash, HASH) never pass through it; Record them to have them checked too.
+class StringHashRegistry
+{
+public:
+	typedef void (*CollisionHandler)(char const * existing, char const * incoming, uint64_t hash, int bits);
+
+	///With no handler, collisions are printed to stderr and assert
+	static void Enable(CollisionHandler handler = nullptr);
+	///Also forgets everything recorded
+	static void Disable();
+	static bool IsEnabled();
+
+	static void Record(StringHash hash, std::string_view string);
+	static void Record(StringHash64 hash, std::string_view string);
+
+	static size_t GetCount();
+
+	///Returns a copy of string that lives until the program exits, for the debug string of a hash built from a temporary.
+	///Copies are shared, so each distinct string costs its length once.  The hashes only intern while the registry is enabled.
+	static char const * Intern(std::string_view string);
+};
+
+}
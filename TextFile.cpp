@@ -1,15 +1,29 @@
 #include "TextFile.h"
+#include "PackArchive.h"
 #include <iostream>
 #include <fstream>
 
 
 void KEngineCore::TextFile::LoadFromFile(const std::string& filename, const std::string& extension)
 {
+	if (!TryLoadFromFile(filename, extension)) {
+		std::cerr << "Unable to open file " + filename + extension;
+		exit(1);   // call system to stop
+	}
+}
+
+bool KEngineCore::TextFile::TryLoadFromFile(const std::string& filename, const std::string& extension)
+{
+	PackArchiveFile packed = PackArchive::FindMounted(filename + extension);
+	if (packed) {
+		mFileContents.assign(packed.GetData(), packed.GetSize());
+		return true;
+	}
+
 	std::ifstream inFile;
 	inFile.open(filename + extension, std::ifstream::in | std::ifstream::binary);
 	if (!inFile) {
-		std::cerr << "Unable to open file " + filename + extension;
-		exit(1);   // call system to stop
+		return false;
 	}
 
 	inFile.seekg(0, std::ios::end);
@@ -17,6 +31,7 @@ void KEngineCore::TextFile::LoadFromFile(const std::string& filename, const std:
 	inFile.seekg(0, std::ios::beg);
 	inFile.read(&mFileContents[0], mFileContents.size());
 	inFile.close();
+	return true;
 }
 
 const std::string& KEngineCore::TextFile::GetContents() const 
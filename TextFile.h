@@ -14,6 +14,8 @@ namespace KEngineCore
     {
     public:
         void LoadFromFile(const std::string& filename, const std::string& extension);
+        //As LoadFromFile, but returns false for a missing or unreadable file instead of exiting
+        bool TryLoadFromFile(const std::string& filename, const std::string& extension);
         const std::string& GetContents() const;
     private:
         std::string mFileContents;
@@ -7,9 +7,22 @@
 
 #import <Foundation/Foundation.h>
 #include "TextFile.h"
+#include "PackArchive.h"
 #include <string>
 
 void KEngineCore::TextFile::LoadFromFile(const std::string& filename, const std::string& extension) {
+    if (!TryLoadFromFile(filename, extension)) {
+        exit(1);
+    }
+}
+
+bool KEngineCore::TextFile::TryLoadFromFile(const std::string& filename, const std::string& extension) {
+    PackArchiveFile packed = PackArchive::FindMounted(filename + extension);
+    if (packed) {
+        mFileContents.assign(packed.GetData(), packed.GetSize());
+        return true;
+    }
+
     NSString * nsFilename = [NSString stringWithUTF8String:filename.c_str()];
     NSString * nsExtension = [NSString stringWithUTF8String:extension.c_str()];
     
@@ -20,9 +33,10 @@ void KEngineCore::TextFile::LoadFromFile(const std::string& filename, const std:
                                                        encoding:NSUTF8StringEncoding error:&error];
     if (!contents) {
         NSLog(@"Error loading text file: %@", error.localizedDescription);
-        exit(1);
+        return false;
     }
     mFileContents = [contents UTF8String];
+    return true;
 }
 
 const std::string& KEngineCore::TextFile::GetContents() const
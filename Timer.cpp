@@ -16,48 +16,27 @@ void KEngineCore::Timer::Init(LuaScheduler * scheduler)
 	mScheduler = scheduler;
 	RegisterLibrary(scheduler->GetMainState());
 	mCurrentTime = 0;
+	mTimeouts.Reset(0);
 	mProcessingTimeout = nullptr;
 }
 
 void KEngineCore::Timer::Deinit()
 {
 	mScheduler = nullptr;
-	mTimeouts.clear();
+	mTimeouts.Clear();
 }
 
+static constexpr int millisecondsPerSecond = 1000;
+
 void KEngineCore::Timer::Update(double time)
-{
-    constexpr int millisecondsPerSecond = 1000;
+{
 	mCurrentTime += time;
-	int currentTime = (int)(mCurrentTime * millisecondsPerSecond);
-	
-	std::vector<Timeout *>	elapsedTimeouts;
-
-	for (auto iterator = mTimeouts.begin(); iterator != mTimeouts.end(); iterator++) {
-		mProcessingTimeout = *iterator;
-		if (mProcessingTimeout->mFiresAt <= currentTime) {
-			mProcessingTimeout->TimeElapsed();
-			if (mProcessingTimeout->mRepeats) {
-				mProcessingTimeout->mFiresAt += (int)(millisecondsPerSecond * mProcessingTimeout->mSetTime);
-			} else {
-				elapsedTimeouts.push_back(mProcessingTimeout);
-			}
-		}
-	}
-	mProcessingTimeout = nullptr;
-	for (auto iterator = elapsedTimeouts.begin(); iterator != elapsedTimeouts.end(); iterator++) {
-		Timeout * timeout = *iterator;
-		mTimeouts.erase(timeout->mPosition);
-		timeout->mPosition = mTimeouts.end();
-	}
-	elapsedTimeouts.clear();
+	mTimeouts.Advance((long long)(mCurrentTime * millisecondsPerSecond));
 }
 
 void KEngineCore::Timer::AddTimeout(Timeout * timeout)
 {
-	mTimeouts.push_front(timeout);
-	timeout->mPosition = mTimeouts.begin();
-	timeout->mFiresAt = (int)((timeout->mSetTime + mCurrentTime) * 1000);
+	mTimeouts.Insert(timeout, (long long)((timeout->mSetTime + mCurrentTime) * millisecondsPerSecond));
 }
 
 void KEngineCore::Timer::ClearTimeout(Timeout * timeout)
@@ -65,8 +44,18 @@ void KEngineCore::Timer::ClearTimeout(Timeout * timeout)
 	if (mProcessingTimeout == timeout) {
 		timeout->mRepeats = false;
 	} else {
-		mTimeouts.erase(timeout->mPosition);		
-		timeout->mPosition = mTimeouts.end();
+		mTimeouts.Remove(timeout);
+	}
+}
+
+void KEngineCore::Timer::FireTimeout(Timeout * timeout)
+{
+	mProcessingTimeout = timeout;
+	timeout->TimeElapsed();
+	mProcessingTimeout = nullptr;
+	if (timeout->mRepeats) {
+		//Re-inserts made during Update are held by the wheel, so a repeat fires at most once per Update as before
+		mTimeouts.Insert(timeout, timeout->GetExpiry() + (long long)(millisecondsPerSecond * timeout->mSetTime));
 	}
 }
 
@@ -74,6 +63,12 @@ void KEngineCore::Timer::ClearTimeout(Timeout * timeout)
 	 return mScheduler;
  }
 
+void KEngineCore::Timer::Sleep(ScheduledLuaThread * thread, double time)
+{
+	thread->Pause();
+	mTimeouts.Insert(thread, (long long)((time + mCurrentTime) * millisecondsPerSecond));
+}
+
 static int setTimeout(lua_State * luaState) {
 	KEngineCore::Timer * timer = (KEngineCore::Timer *)lua_touserdata(luaState, lua_upvalueindex(1));
 	KEngineCore::LuaScheduler * scheduler = timer->GetLuaScheduler();
@@ -120,19 +115,18 @@ static int clearTimeout(lua_State * luaState) {
 static int waits(lua_State * luaState) {
 	KEngineCore::Timer * timer = (KEngineCore::Timer *)lua_touserdata(luaState, lua_upvalueindex(1));
 	KEngineCore::LuaScheduler * scheduler = timer->GetLuaScheduler();
+#ifndef NDEBUG
+	size_t allocations = scheduler->GetAllocationCount();
+#endif
 	double requestedTime = luaL_checknumber(luaState, 1);
-	
-	KEngineCore::Timeout * timeout = new (lua_newuserdata(luaState, sizeof(KEngineCore::Timeout))) KEngineCore::Timeout;
-	luaL_getmetatable(luaState, "KEngineCore.Timeout");
-	lua_setmetatable(luaState, -2);
 
 	KEngineCore::ScheduledLuaThread * scheduledThread = scheduler->GetScheduledThread(luaState);
-	scheduledThread->Pause();
-
-	timeout->Init(timer, requestedTime, false, [scheduledThread] () {
-		scheduledThread->Resume();
-	});
-	return lua_yield(luaState, 1);  //Pretend we're going to pass the timeout to resume so it doesn't get GC'd
+	if (scheduledThread == nullptr) {
+		return luaL_error(luaState, "waits called outside of a scheduled thread");
+	}
+	timer->Sleep(scheduledThread, requestedTime);  //The thread itself sits in the timer, so there's nothing to allocate or keep alive
+	assert(scheduler->GetAllocationCount() == allocations);  //A wait must not create any Lua objects
+	return lua_yield(luaState, 0);
 }
 
 static int deleteTimeout(lua_State * luaState) {
@@ -177,7 +171,6 @@ KEngineCore::Timeout::Timeout()
 {
 	mTimer = nullptr;
 	mSetTime = 0;
-	mFiresAt = 0;
 	mRepeats = false;
 }
 
@@ -199,9 +192,7 @@ void KEngineCore::Timeout::Init(Timer *timer, double time, bool repeats, std::fu
 
 void KEngineCore::Timeout::Deinit()
 {
-	if (mTimer && mPosition != mTimer->mTimeouts.end()) {
-		Cancel();
-	}
+	Cancel();
 	mTimer = nullptr;
 }
 
@@ -211,8 +202,13 @@ void KEngineCore::Timeout::TimeElapsed()
 	mCallback();
 }
 
+void KEngineCore::Timeout::Expire()
+{
+	mTimer->FireTimeout(this);
+}
+
 void KEngineCore::Timeout::Cancel() {
-	if (mTimer != nullptr && mPosition != mTimer->mTimeouts.end()) {
+	if (mTimer != nullptr && (IsScheduled() || mTimer->mProcessingTimeout == this)) {
 		mTimer->ClearTimeout(this);
 		if (mCancelCallback) {
 			mCancelCallback();
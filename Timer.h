@@ -1,13 +1,13 @@
 #pragma once
 
 #include "LuaLibrary.h"
+#include "TimingWheel.h"
 #include <functional>
-#include <list>
-#include <vector>
 
 namespace KEngineCore {
 
 class LuaScheduler;
+class ScheduledLuaThread;
 class Timeout;
 
 class Timer : protected LuaLibrary
@@ -24,18 +24,22 @@ public:
 	void Update(double time);
 	LuaScheduler * GetLuaScheduler() const;
 
+	///Parks the thread in the timer until time has elapsed, then resumes it.  Allocates nothing.
+	void Sleep(ScheduledLuaThread * thread, double time);
+
 private:
 	void AddTimeout(Timeout * timeout);
 	void ClearTimeout(Timeout * handler);
+	void FireTimeout(Timeout * timeout);
 
     LuaScheduler *			mScheduler {nullptr};
-	std::list<Timeout *>	mTimeouts;
+	TimingWheel				mTimeouts;
     double					mCurrentTime {0.0};
     Timeout *				mProcessingTimeout {nullptr};
 	friend class Timeout;
 };
 
-class Timeout 
+class Timeout : public TimingWheelNode
 {
 public:
 	Timeout();
@@ -48,11 +52,11 @@ public:
 	void Cancel();
 
 private:
+	void Expire() override;
+
 	Timer *							mTimer;
     double							mSetTime {0.0};
-    int								mFiresAt {0};
     bool							mRepeats {false};
-	std::list<Timeout *>::iterator	mPosition;
     std::function<void()>			mCallback {nullptr};
     std::function<void()>			mCancelCallback {nullptr};
 	friend class Timer;
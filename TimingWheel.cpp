@@ -0,0 +1,299 @@
+#include "TimingWheel.h"
+#include <cassert>
+#include <climits>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static int CountTrailingZeros(uint64_t bits)
+{
+	assert(bits != 0);
+#if defined(_MSC_VER)
+	unsigned long index;
+#if defined(_WIN64)
+	_BitScanForward64(&index, bits);
+	return (int)index;
+#else
+	if (_BitScanForward(&index, (unsigned long)bits)) {
+		return (int)index;
+	}
+	_BitScanForward(&index, (unsigned long)(bits >> 32));
+	return (int)index + 32;
+#endif
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+static uint64_t RotateRight(uint64_t bits, int shift)
+{
+	return shift == 0 ? bits : (bits >> shift) | (bits << (64 - shift));
+}
+
+static bool IsEmpty(KEngineCore::TimingWheelLink const * sentinel)
+{
+	return sentinel->mNext == sentinel;
+}
+
+static void InitSentinel(KEngineCore::TimingWheelLink * sentinel)
+{
+	sentinel->mNext = sentinel;
+	sentinel->mPrev = sentinel;
+}
+
+static void LinkBefore(KEngineCore::TimingWheelLink * link, KEngineCore::TimingWheelLink * sentinel)
+{
+	link->mNext = sentinel;
+	link->mPrev = sentinel->mPrev;
+	sentinel->mPrev->mNext = link;
+	sentinel->mPrev = link;
+}
+
+///Moves the whole contents of one list onto the (empty) other.
+static void Splice(KEngineCore::TimingWheelLink * from, KEngineCore::TimingWheelLink * to)
+{
+	assert(IsEmpty(to));
+	if (!IsEmpty(from)) {
+		to->mNext = from->mNext;
+		to->mPrev = from->mPrev;
+		to->mNext->mPrev = to;
+		to->mPrev->mNext = to;
+		InitSentinel(from);
+	}
+}
+
+KEngineCore::TimingWheelNode::TimingWheelNode()
+{
+}
+
+KEngineCore::TimingWheelNode::~TimingWheelNode()
+{
+	Unschedule();
+}
+
+bool KEngineCore::TimingWheelNode::IsScheduled() const
+{
+	return mWheel != nullptr;
+}
+
+long long KEngineCore::TimingWheelNode::GetExpiry() const
+{
+	return mExpiry;
+}
+
+void KEngineCore::TimingWheelNode::Unschedule()
+{
+	if (mWheel != nullptr) {
+		mWheel->Remove(this);
+	}
+}
+
+void KEngineCore::TimingWheelNode::Unlink()
+{
+	if (mNext != nullptr) {
+		mPrev->mNext = mNext;
+		mNext->mPrev = mPrev;
+		mNext = nullptr;
+		mPrev = nullptr;
+	}
+}
+
+KEngineCore::TimingWheel::TimingWheel()
+{
+	for (int level = 0; level < kLevelCount; level++) {
+		for (int slot = 0; slot < kSlotCount; slot++) {
+			InitSentinel(&mSlots[level][slot]);
+		}
+	}
+	InitSentinel(&mHeld);
+	InitSentinel(&mOverdue);
+	InitSentinel(&mExpiring);
+}
+
+KEngineCore::TimingWheel::~TimingWheel()
+{
+	Clear();
+}
+
+void KEngineCore::TimingWheel::Reset(long long time)
+{
+	Clear();
+	mTime = time;
+}
+
+void KEngineCore::TimingWheel::Clear()
+{
+	auto clearList = [this] (TimingWheelLink * sentinel) {
+		while (!IsEmpty(sentinel)) {
+			Remove(static_cast<TimingWheelNode *>(sentinel->mNext));
+		}
+	};
+	for (int level = 0; level < kLevelCount; level++) {
+		for (int slot = 0; slot < kSlotCount; slot++) {
+			clearList(&mSlots[level][slot]);
+		}
+		mOccupied[level] = 0;
+	}
+	clearList(&mHeld);
+	clearList(&mOverdue);
+	clearList(&mExpiring);
+	assert(mCount == 0);
+}
+
+void KEngineCore::TimingWheel::Insert(TimingWheelNode * node, long long expiry)
+{
+	if (node->mWheel != nullptr) {
+		node->mWheel->Remove(node);
+	}
+	node->mWheel = this;
+	node->mExpiry = expiry;
+	mCount++;
+	if (mAdvancing) {
+		LinkBefore(node, &mHeld);
+	} else {
+		Place(node);
+	}
+}
+
+void KEngineCore::TimingWheel::Remove(TimingWheelNode * node)
+{
+	if (node->mWheel == this) {
+		node->Unlink();
+		node->mWheel = nullptr;
+		mCount--;
+	}
+}
+
+void KEngineCore::TimingWheel::Advance(long long time)
+{
+	assert(!mAdvancing);
+	if (mCount == 0) {
+		//Nothing to expire, so there's nothing to cascade either
+		if (mTime <= time) {
+			mTime = time + 1;
+		}
+		return;
+	}
+	mAdvancing = true;
+	//Anything overdue was already due before this call's first tick
+	ExpireList(&mOverdue);
+	while (mTime <= time) {
+		long long next = NextEventTime();
+		if (next > time) {
+			mTime = time + 1;
+			break;
+		}
+		mTime = next;
+
+		//Lower levels are cascaded first; a higher level is only reached when every index below it has wrapped.
+		int slot = (int)(mTime & kSlotMask);
+		for (int level = 1; slot == 0 && level < kLevelCount; level++) {
+			slot = (int)((mTime >> (kSlotBits * level)) & kSlotMask);
+			Cascade(level, slot);
+		}
+
+		ExpireSlot((int)(mTime & kSlotMask));
+		mTime++;
+	}
+	mAdvancing = false;
+	FlushHeld();
+}
+
+long long KEngineCore::TimingWheel::GetTime() const
+{
+	return mTime;
+}
+
+size_t KEngineCore::TimingWheel::GetCount() const
+{
+	return mCount;
+}
+
+void KEngineCore::TimingWheel::Place(TimingWheelNode * node)
+{
+	if (node->mExpiry < mTime) {
+		//The tick it wanted has been processed already; it goes out first thing next Advance, whatever time that's for
+		LinkBefore(node, &mOverdue);
+		return;
+	}
+	long long expiry = node->mExpiry;
+	long long delta = expiry - mTime;
+	if (delta > kMaxDelta) {
+		//Too far out for the wheel; park it in the furthest slot and let cascading re-place it later.
+		expiry = mTime + kMaxDelta;
+		delta = kMaxDelta;
+	}
+	int level = 0;
+	while (delta >= (1LL << (kSlotBits * (level + 1)))) {
+		level++;
+	}
+	int slot = (int)((expiry >> (kSlotBits * level)) & kSlotMask);
+	LinkBefore(node, &mSlots[level][slot]);
+	mOccupied[level] |= 1ULL << slot;
+}
+
+long long KEngineCore::TimingWheel::NextEventTime() const
+{
+	//Occupancy bits may be stale (set for a slot that has since emptied), which only costs a wasted visit.
+	long long next = LLONG_MAX;
+	for (int level = 0; level < kLevelCount; level++) {
+		if (mOccupied[level] == 0) {
+			continue;
+		}
+		int shift = kSlotBits * level;
+		long long block = mTime >> shift;
+		uint64_t pending = RotateRight(mOccupied[level], (int)(block & kSlotMask));
+		long long candidate;
+		if (level == 0) {
+			candidate = mTime + CountTrailingZeros(pending);
+		} else {
+			//A level's slot is cascaded when time reaches the start of its block, so the current block only counts if we're sitting on its start.
+			bool aligned = (mTime & ((1LL << shift) - 1)) == 0;
+			uint64_t ahead = aligned ? pending : (pending & ~1ULL);
+			int blocks = ahead != 0 ? CountTrailingZeros(ahead) : kSlotCount;
+			candidate = (block + blocks) << shift;
+		}
+		if (candidate < next) {
+			next = candidate;
+		}
+	}
+	return next;
+}
+
+void KEngineCore::TimingWheel::Cascade(int level, int slot)
+{
+	TimingWheelLink cascading;
+	InitSentinel(&cascading);
+	Splice(&mSlots[level][slot], &cascading);
+	mOccupied[level] &= ~(1ULL << slot);
+	while (!IsEmpty(&cascading)) {
+		TimingWheelNode * node = static_cast<TimingWheelNode *>(cascading.mNext);
+		node->Unlink();
+		Place(node);
+	}
+}
+
+void KEngineCore::TimingWheel::ExpireSlot(int slot)
+{
+	mOccupied[0] &= ~(1ULL << slot);
+	ExpireList(&mSlots[0][slot]);
+}
+
+void KEngineCore::TimingWheel::ExpireList(TimingWheelLink * sentinel)
+{
+	Splice(sentinel, &mExpiring);
+	while (!IsEmpty(&mExpiring)) {
+		TimingWheelNode * node = static_cast<TimingWheelNode *>(mExpiring.mNext);
+		Remove(node);
+		node->Expire();
+	}
+}
+
+void KEngineCore::TimingWheel::FlushHeld()
+{
+	while (!IsEmpty(&mHeld)) {
+		TimingWheelNode * node = static_cast<TimingWheelNode *>(mHeld.mNext);
+		node->Unlink();
+		Place(node);
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace KEngineCore {
+
+class TimingWheel;
+
+///Intrusive list link, used both by scheduled nodes and by the wheel's slot sentinels.
+struct TimingWheelLink
+{
+	TimingWheelLink *	mNext {nullptr};
+	TimingWheelLink *	mPrev {nullptr};
+};
+
+///Anything that can sit in a TimingWheel.  The node carries its own links, so scheduling never allocates.
+class TimingWheelNode : protected TimingWheelLink
+{
+public:
+	TimingWheelNode();
+	virtual ~TimingWheelNode();
+
+	bool IsScheduled() const;
+	long long GetExpiry() const;
+	void Unschedule();
+
+protected:
+	///Called by the wheel once the expiry tick has been reached.  The node is already unscheduled at this point.
+	virtual void Expire() = 0;
+
+private:
+	void Unlink();
+
+	long long		mExpiry {0};
+	TimingWheel *	mWheel {nullptr};
+
+	friend class TimingWheel;
+};
+
+///Hierarchical timing wheel with millisecond ticks.  Insert and remove are O(1); advancing costs
+///O(1) per occupied slot or cascade boundary crossed, regardless of how many nodes are pending.
+class TimingWheel
+{
+public:
+	TimingWheel();
+	~TimingWheel();
+
+	void Reset(long long time = 0);
+	void Clear();
+
+	void Insert(TimingWheelNode * node, long long expiry);
+	void Remove(TimingWheelNode * node);
+
+	///Expires every node with an expiry at or before time, including any inserted after the wheel had already passed
+	///their expiry.  Nodes inserted while this runs are held until it returns, so they wait for the next Advance.
+	void Advance(long long time);
+
+	long long GetTime() const;
+	size_t GetCount() const;
+
+private:
+	static constexpr int			kSlotBits = 6;
+	static constexpr int			kSlotCount = 1 << kSlotBits;
+	static constexpr int			kSlotMask = kSlotCount - 1;
+	static constexpr int			kLevelCount = 5;
+	static constexpr long long		kMaxDelta = (1LL << (kSlotBits * kLevelCount)) - 1;
+
+	void Place(TimingWheelNode * node);
+	long long NextEventTime() const;
+	void Cascade(int level, int slot);
+	void ExpireSlot(int slot);
+	void ExpireList(TimingWheelLink * sentinel);
+	void FlushHeld();
+
+	TimingWheelLink		mSlots[kLevelCount][kSlotCount];
+	uint64_t			mOccupied[kLevelCount] {};	///Bit per slot that may hold nodes
+	TimingWheelLink		mHeld;		///Nodes inserted during Advance
+	TimingWheelLink		mOverdue;	///Nodes inserted with an expiry already passed, expired by the next Advance
+	TimingWheelLink		mExpiring;	///Slot currently being expired
+	long long			mTime {0};	///Next tick to be processed
+	size_t				mCount {0};
+	bool				mAdvancing {false};
+};
+
+}
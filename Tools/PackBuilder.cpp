@@ -0,0 +1,112 @@
+//Packs every file under a directory into one PackArchive (see PackArchive.h).
+//
+//	PackBuilder <output.pak> <directory> [prefix]
+//
+//Each file is keyed by prefix + its path relative to the directory, with / separators; that has to match the
+//filename + extension the game passes to TextFile or BinaryFile.  So if the game loads "assets/ui/font.png", pack
+//the assets directory with the prefix "assets/".  Two paths with the same StringHash fail the build.
+//
+//Builds on its own against the engine headers, e.g.  c++ -std=c++17 -I.. PackBuilder.cpp
+
+#include "Crc32.h"
+#include "PackArchive.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+struct PackedFile {
+	std::string						mKey;
+	std::filesystem::path			mPath;
+	KEngineCore::PackArchiveEntry	mEntry;
+};
+
+static const uint64_t kAlignment = 16;
+
+static uint64_t align(uint64_t offset) {
+	return (offset + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+int main(int argc, char ** argv) {
+	if (argc < 3 || argc > 4) {
+		fprintf(stderr, "Usage: %s <output.pak> <directory> [prefix]\n", argv[0]);
+		return 1;
+	}
+	std::filesystem::path root(argv[2]);
+	std::string prefix = argc > 3 ? argv[3] : "";
+
+	std::vector<PackedFile> files;
+	std::error_code error;
+	for (std::filesystem::recursive_directory_iterator it(root, error), end; !error && it != end; it.increment(error)) {
+		if (!it->is_regular_file()) {
+			continue;
+		}
+		PackedFile file;
+		file.mPath = it->path();
+		file.mKey = prefix + file.mPath.lexically_relative(root).generic_string();
+		memset(&file.mEntry, 0, sizeof(file.mEntry));
+		file.mEntry.mHash = KEngineCore::Crc32(file.mKey.data(), file.mKey.size());
+		file.mEntry.mCheck = KEngineCore::PackArchive::GetCheckHash(file.mKey.data(), file.mKey.size());
+		file.mEntry.mSize = (uint64_t)it->file_size();
+		files.push_back(std::move(file));
+	}
+	if (error) {
+		fprintf(stderr, "Couldn't read %s: %s\n", argv[2], error.message().c_str());
+		return 1;
+	}
+
+	//Sorted by hash so the index is in a stable, searchable order whatever order the directory listed in
+	std::sort(files.begin(), files.end(), [] (PackedFile const & a, PackedFile const & b) { return a.mEntry.mHash < b.mEntry.mHash; });
+	for (size_t index = 1; index < files.size(); index++) {
+		if (files[index].mEntry.mHash == files[index - 1].mEntry.mHash) {
+			fprintf(stderr, "\"%s\" and \"%s\" have the same hash %08x\n", files[index - 1].mKey.c_str(), files[index].mKey.c_str(), files[index].mEntry.mHash);
+			return 1;
+		}
+	}
+
+	uint64_t offset = align(sizeof(KEngineCore::PackArchiveHeader) + files.size() * sizeof(KEngineCore::PackArchiveEntry));
+	for (auto & file : files) {
+		file.mEntry.mOffset = offset;
+		offset = align(offset + file.mEntry.mSize);
+	}
+
+	std::ofstream output(argv[1], std::ios::binary | std::ios::trunc);
+	if (!output) {
+		fprintf(stderr, "Couldn't write %s\n", argv[1]);
+		return 1;
+	}
+	KEngineCore::PackArchiveHeader header;
+	memcpy(header.mMagic, "KPAK", 4);
+	header.mVersion = KEngineCore::PackArchive::kVersion;
+	header.mEntryCount = (uint32_t)files.size();
+	header.mReserved = 0;
+	output.write((char const *)&header, sizeof(header));
+	for (auto const & file : files) {
+		output.write((char const *)&file.mEntry, sizeof(file.mEntry));
+	}
+
+	std::vector<char> contents;
+	char const padding[kAlignment] = {};
+	uint64_t written = sizeof(header) + files.size() * sizeof(KEngineCore::PackArchiveEntry);
+	for (auto const & file : files) {
+		output.write(padding, (std::streamsize)(file.mEntry.mOffset - written));
+		std::ifstream input(file.mPath, std::ios::binary);
+		contents.resize((size_t)file.mEntry.mSize);
+		if (!input.read(contents.data(), (std::streamsize)contents.size())) {
+			fprintf(stderr, "Couldn't read %s\n", file.mPath.string().c_str());
+			return 1;
+		}
+		output.write(contents.data(), (std::streamsize)contents.size());
+		written = file.mEntry.mOffset + file.mEntry.mSize;
+	}
+	output.close();
+	if (!output) {
+		fprintf(stderr, "Error writing %s\n", argv[1]);
+		return 1;
+	}
+	printf("%s: %zu files, %llu bytes\n", argv[1], files.size(), (unsigned long long)written);
+	return 0;
+}
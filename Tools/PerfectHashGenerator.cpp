@@ -0,0 +1,197 @@
+//Emits a header holding a minimal perfect hash table (see PerfectHashTable.h) for a closed set of names.
+//
+//	PerfectHashGenerator <names.txt> <output.h> <TableName> [namespace]
+//
+//One name per line; surrounding whitespace, blank lines and lines starting with # are ignored.  Keys are the same
+//CRC32 as StringHash and "name"_hash, so the table is queried with the hashes the engine already has.  Distinct
+//names with the same CRC can't be told apart at runtime, so they fail generation rather than silently aliasing.
+//
+//Builds on its own against the engine headers, e.g.  c++ -std=c++17 -I.. PerfectHashGenerator.cpp
+
+#include "Crc32.h"
+#include "PerfectHashTable.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <unordered_map>
+
+using KEngineCore::PerfectHashFunction;
+
+struct Key {
+	std::string		mName;
+	uint32_t		mHash;
+};
+
+static const uint32_t kMaxSeedAttempts = 1 << 24;
+
+static bool readNames(char const * path, std::vector<Key> & keys) {
+	std::ifstream input(path);
+	if (!input) {
+		fprintf(stderr, "Couldn't open %s\n", path);
+		return false;
+	}
+	std::unordered_map<uint32_t, std::string> seen;
+	std::string line;
+	int lineNumber = 0;
+	bool ok = true;
+	while (std::getline(input, line)) {
+		lineNumber++;
+		size_t first = line.find_first_not_of(" \t\r\n");
+		if (first == std::string::npos || line[first] == '#') {
+			continue;
+		}
+		size_t last = line.find_last_not_of(" \t\r\n");
+		Key key;
+		key.mName = line.substr(first, last - first + 1);
+		key.mHash = KEngineCore::Crc32(key.mName.data(), key.mName.size());
+		auto existing = seen.find(key.mHash);
+		if (existing != seen.end()) {
+			if (existing->second == key.mName) {
+				fprintf(stderr, "%s(%d): duplicate name \"%s\"\n", path, lineNumber, key.mName.c_str());
+			} else {
+				fprintf(stderr, "%s(%d): \"%s\" and \"%s\" have the same hash %08x\n", path, lineNumber, key.mName.c_str(), existing->second.c_str(), key.mHash);
+			}
+			ok = false;
+			continue;
+		}
+		seen[key.mHash] = key.mName;
+		keys.push_back(key);
+	}
+	if (ok && keys.empty()) {
+		fprintf(stderr, "%s has no names\n", path);
+		ok = false;
+	}
+	return ok;
+}
+
+//Hash and displace: keys are split into small buckets, and each bucket, largest first, searches for a seed that lands
+//all its keys in free slots.  Big buckets go while the table is emptiest, which is what keeps the search short.
+static bool buildTable(std::vector<Key> const & keys, size_t bucketCount, std::vector<uint32_t> & seeds, std::vector<int> & slots) {
+	size_t keyCount = keys.size();
+	std::vector<std::vector<size_t>> buckets(bucketCount);
+	for (size_t index = 0; index < keyCount; index++) {
+		buckets[PerfectHashFunction::GetBucket(keys[index].mHash, bucketCount)].push_back(index);
+	}
+	std::vector<size_t> order(bucketCount);
+	for (size_t index = 0; index < bucketCount; index++) {
+		order[index] = index;
+	}
+	std::stable_sort(order.begin(), order.end(), [&buckets] (size_t a, size_t b) { return buckets[a].size() > buckets[b].size(); });
+
+	seeds.assign(bucketCount, 0);
+	slots.assign(keyCount, -1);
+	std::vector<size_t> placed;
+	for (size_t bucketIndex : order) {
+		std::vector<size_t> const & bucket = buckets[bucketIndex];
+		if (bucket.empty()) {
+			break;
+		}
+		bool found = false;
+		for (uint32_t seed = 0; seed < kMaxSeedAttempts && !found; seed++) {
+			placed.clear();
+			found = true;
+			for (size_t keyIndex : bucket) {
+				size_t slot = PerfectHashFunction::GetSlot(keys[keyIndex].mHash, seed, keyCount);
+				if (slots[slot] != -1 || std::find(placed.begin(), placed.end(), slot) != placed.end()) {
+					found = false;
+					break;
+				}
+				placed.push_back(slot);
+			}
+			if (found) {
+				seeds[bucketIndex] = seed;
+				for (size_t index = 0; index < bucket.size(); index++) {
+					slots[placed[index]] = (int)bucket[index];
+				}
+			}
+		}
+		if (!found) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//As a C string literal; also keeps a trailing backslash from continuing a // comment onto the next line
+static void writeQuoted(FILE * output, std::string const & name) {
+	fputc('"', output);
+	for (char character : name) {
+		if (character == '"' || character == '\\') {
+			fputc('\\', output);
+		}
+		fputc(character, output);
+	}
+	fputc('"', output);
+}
+
+static bool writeHeader(char const * path, char const * tableName, char const * nameSpace, char const * sourcePath, std::vector<Key> const & keys, std::vector<uint32_t> const & seeds, std::vector<int> const & slots) {
+	FILE * output = fopen(path, "w");
+	if (output == nullptr) {
+		fprintf(stderr, "Couldn't write %s\n", path);
+		return false;
+	}
+	fprintf(output, "#pragma once\n//Generated by PerfectHashGenerator from %s; don't edit\n\n#include \"PerfectHashTable.h\"\n\n", sourcePath);
+	if (nameSpace != nullptr) {
+		fprintf(output, "namespace %s {\n\n", nameSpace);
+	}
+	fprintf(output, "constexpr KEngineCore::PerfectHashTable<%zu, %zu> %s {\n\t{", keys.size(), seeds.size(), tableName);
+	for (size_t index = 0; index < seeds.size(); index++) {
+		fprintf(output, "%s%s%u", index == 0 ? "" : ",", index % 16 == 0 ? "\n\t\t" : " ", seeds[index]);
+	}
+	fprintf(output, "\n\t},\n\t{\n");
+	for (size_t slot = 0; slot < slots.size(); slot++) {
+		fprintf(output, "\t\t0x%08xu,\t//", keys[slots[slot]].mHash);
+		writeQuoted(output, keys[slots[slot]].mName);
+		fputs("\n", output);
+	}
+	fprintf(output, "\t}\n};\n\n");
+	fprintf(output, "//Names in slot order, for messages and debugging\nconstexpr char const * %sNames[] {\n", tableName);
+	for (size_t slot = 0; slot < slots.size(); slot++) {
+		fputs("\t", output);
+		writeQuoted(output, keys[slots[slot]].mName);
+		fputs(",\n", output);
+	}
+	fprintf(output, "};\n");
+	if (nameSpace != nullptr) {
+		fprintf(output, "\n}\n");
+	}
+	bool ok = ferror(output) == 0;
+	ok = fclose(output) == 0 && ok;
+	if (!ok) {
+		fprintf(stderr, "Error writing %s\n", path);
+	}
+	return ok;
+}
+
+int main(int argc, char ** argv) {
+	if (argc < 4 || argc > 5) {
+		fprintf(stderr, "Usage: %s <names.txt> <output.h> <TableName> [namespace]\n", argv[0]);
+		return 1;
+	}
+	std::vector<Key> keys;
+	if (!readNames(argv[1], keys)) {
+		return 1;
+	}
+
+	//About four keys a bucket is quick to solve while keeping the seed table a quarter the size of the key table;
+	//if some bucket still can't be placed, more, smaller buckets make it easier
+	size_t bucketCount = (keys.size() + 3) / 4;
+	std::vector<uint32_t> seeds;
+	std::vector<int> slots;
+	while (!buildTable(keys, bucketCount, seeds, slots)) {
+		if (bucketCount >= keys.size()) {
+			fprintf(stderr, "Couldn't find a perfect hash for %s\n", argv[1]);
+			return 1;
+		}
+		bucketCount = std::min(keys.size(), bucketCount * 2);
+	}
+
+	if (!writeHeader(argv[2], argv[3], argc > 4 ? argv[4] : nullptr, argv[1], keys, seeds, slots)) {
+		return 1;
+	}
+	printf("%s: %zu names, %zu buckets\n", argv[2], keys.size(), bucketCount);
+	return 0;
+}
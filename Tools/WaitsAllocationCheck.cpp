@@ -0,0 +1,128 @@
+//Checks that timer.waits allocates nothing once it's warmed up: neither Lua objects nor C++ heap memory.
+//
+//	WaitsAllocationCheck [threads] [frames]
+//
+//Runs that many scheduled threads, each looping on timer.waits with its own period, through a few hundred frames so
+//the scheduler's vectors and slot maps reach their working size, then counts every allocation made through the Lua
+//allocator and the global operator new over the measured frames.  Exits with 1 if there are any.
+//
+//Links against the engine and Lua, e.g.  c++ -std=c++17 -I.. -I../Lua WaitsAllocationCheck.cpp <engine sources> liblua.a
+
+#include "LuaScheduler.h"
+#include "Timer.h"
+#include "Lua/lua.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+
+static bool sCounting = false;
+static size_t sNewCount = 0;
+static size_t sLuaCount = 0;
+
+void * operator new(size_t size) {
+	if (sCounting) {
+		sNewCount++;
+	}
+	void * memory = malloc(size > 0 ? size : 1);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void * operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void * memory) noexcept {
+	free(memory);
+}
+
+void operator delete[](void * memory) noexcept {
+	operator delete(memory);
+}
+
+void operator delete(void * memory, size_t) noexcept {
+	operator delete(memory);
+}
+
+void operator delete[](void * memory, size_t) noexcept {
+	operator delete(memory);
+}
+
+struct LuaAllocator {
+	lua_Alloc	mAllocator;
+	void *		mUserData;
+};
+
+static void * countLuaAllocation(void * userData, void * pointer, size_t oldSize, size_t newSize) {
+	LuaAllocator * allocator = (LuaAllocator *)userData;
+	if (sCounting && newSize > 0 && (pointer == nullptr || newSize > oldSize)) {
+		sLuaCount++;
+	}
+	return allocator->mAllocator(allocator->mUserData, pointer, oldSize, newSize);
+}
+
+static const char * kWaitLoop =
+	"local timer = require 'timer'\n"
+	"local period = ...\n"
+	"local waited = 0\n"
+	"while true do\n"
+	"	timer.waits(period)\n"
+	"	waited = waited + 1\n"
+	"end\n";
+
+int main(int argc, char ** argv) {
+	int threadCount = argc > 1 ? atoi(argv[1]) : 64;
+	int frames = argc > 2 ? atoi(argv[2]) : 1000;
+	const int kWarmupFrames = 300;
+	const double kFrameTime = 1.0 / 60.0;
+
+	KEngineCore::LuaScheduler scheduler;
+	scheduler.Init();
+	KEngineCore::Timer timer;
+	timer.Init(&scheduler);
+	lua_State * mainState = scheduler.GetMainState();
+
+	LuaAllocator allocator;
+	allocator.mAllocator = lua_getallocf(mainState, &allocator.mUserData);
+	lua_setallocf(mainState, countLuaAllocation, &allocator);
+	//So that only the wait path is measured, not garbage the collector happens to free and reallocate
+	lua_gc(mainState, LUA_GCSTOP, 0);
+
+	std::vector<KEngineCore::ScheduledLuaThread> threads(threadCount);  //Sized once, so the threads never move
+	for (int index = 0; index < threadCount; index++) {
+		lua_State * threadState = lua_newthread(mainState);
+		if (luaL_loadstring(threadState, kWaitLoop) != LUA_OK) {
+			fprintf(stderr, "%s\n", lua_tostring(threadState, -1));
+			return 1;
+		}
+		lua_pushnumber(threadState, 0.01 + 0.005 * (index % 7));  //Mixed periods, so wakes land in different frames
+		threads[index].Init(&scheduler, threadState);
+		threads[index].Resume(1);
+		lua_pop(mainState, 1);  //Anchored by the scheduler now
+	}
+
+	for (int frame = 0; frame < kWarmupFrames; frame++) {
+		timer.Update(kFrameTime);
+		scheduler.Update();
+	}
+
+	sCounting = true;
+	for (int frame = 0; frame < frames; frame++) {
+		timer.Update(kFrameTime);
+		scheduler.Update();
+	}
+	sCounting = false;
+
+	bool passed = sNewCount == 0 && sLuaCount == 0;
+	printf("%d threads, %d frames: %zu operator new, %zu Lua allocations: %s\n", threadCount, frames, sNewCount, sLuaCount, passed ? "ok" : "FAILED");
+
+	for (auto it = threads.begin(); it != threads.end(); it++) {
+		it->Deinit();
+	}
+	timer.Deinit();
+	scheduler.Deinit();
+	return passed ? 0 : 1;
+}
@@ -4,6 +4,10 @@
 #include <vector>
 #include <cassert>
 #include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <map>
+#include <tuple>
 
 
 namespace KEngineCore {
@@ -11,6 +15,16 @@ namespace KEngineCore {
 	template <class TClass>
 	class Updater;
 
+	template <class TClass>
+	class ParallelUpdater;
+
+	///Phases run in order each Update; within a phase, higher priorities run first
+	enum class UpdatePhase {
+		Pre,
+		Main,
+		Late
+	};
+
 	///------------------------------------------------------------------------
 	///------------------------------------------------------------------------
 
@@ -25,17 +39,31 @@ namespace KEngineCore {
 
 		void Start();
 		void Stop();
+
+		///An interval of N updates the object every Nth Update with the time accumulated since.  Objects sharing an
+		///interval are staggered across those N frames to keep the load flat.  Takes effect right away if updating.
+		void SetUpdateSchedule(UpdatePhase phase, int priority = 0, unsigned int interval = 1);
 	protected:
 		///Init is protected because most template instances will need to override it with more parameters.
 		void Init(Updater<TClass> * updater);
 
 		///Only the associated Updater should call Update
 		void Update(double time);
+		///Updates with the time the lane has accumulated, less whatever it had already accumulated when this joined
+		void UpdateFromLane(double laneTime);
 
         Updater<TClass> *	mUpdater {nullptr};
         bool				mUpdating {false};
+		bool				mPendingAdd {false};		///Started during an update pass, so waiting in the pending list rather than a lane
+		size_t				mUpdateIndex {SIZE_MAX};	///Position in whichever of those lists holds it
+		std::vector<Updating<TClass> *> *	mLane {nullptr};
+		UpdatePhase			mPhase {UpdatePhase::Main};
+		int					mPriority {0};
+		unsigned int		mInterval {1};
+		double				mJoinedLaneTime {0.0};		///The lane's accumulated time when this joined it, which predates this
 
 		friend class Updater<TClass>;
+		friend class ParallelUpdater<TClass>;
 	};
 
 	///------------------------------------------------------------------------
@@ -102,6 +130,26 @@ namespace KEngineCore {
 
 	///------------------------------------------------------------------------
 
+	template <class TClass>
+	void Updating<TClass>::SetUpdateSchedule(UpdatePhase phase, int priority, unsigned int interval)
+	{
+		assert(interval > 0);
+		bool updating = mUpdating;
+		if (updating)
+		{
+			Stop();
+		}
+		mPhase = phase;
+		mPriority = priority;
+		mInterval = interval;
+		if (updating)
+		{
+			Start();
+		}
+	}
+
+	///------------------------------------------------------------------------
+
 	template <class TClass>
 	void Updating<TClass>::Update( double fTime )
 	{
@@ -110,6 +158,16 @@ namespace KEngineCore {
 		TClass::Update(fTime);
 	}
 
+	///------------------------------------------------------------------------
+
+	template <class TClass>
+	void Updating<TClass>::UpdateFromLane( double laneTime )
+	{
+		double time = laneTime - mJoinedLaneTime;
+		mJoinedLaneTime = 0.0;
+		Update(time);
+	}
+
 	
 	///------------------------------------------------------------------------
 	///------------------------------------------------------------------------
@@ -126,12 +184,40 @@ namespace KEngineCore {
 
 		void Update(double fTime);
 
+		size_t GetCount() const;
+
 	protected:
+		typedef std::vector<Updating<TClass> *> Lane;
+
+		///Everything sharing a phase, priority and interval.  Each object sits in one of interval lanes, and one lane is due per Update.
+		struct Group
+		{
+			std::vector<Lane>		mLanes;
+			std::vector<double>		mLaneTimes;	///Time accumulated since each lane last ran
+		};
+
+		///Sorts by phase, then highest priority first
+		typedef std::tuple<UpdatePhase, int, unsigned int> GroupKey;
+
 		void AddToUpdateList(Updating<TClass> * updatable);
 		void RemoveFromUpdateList(Updating<TClass> * updatable);
-
-		std::vector<Updating<TClass> *>	mUpdateList;
+		void Place(Updating<TClass> * updatable);
+
+		///Calls runLane(lane, time) for each lane due this Update, in phase and priority order, with the pass bookkeeping around it
+		template <class TRunLane>
+		void RunUpdatePass(double fTime, TRunLane const & runLane);
+		void FinishUpdatePass();
+
+		///Removal swaps the last entry of the lane into the hole, so update order within a group isn't stable.
+		///During an update pass, removals leave a null tombstone and additions wait in mPendingAdds; both are settled when the pass ends.
+		std::map<GroupKey, Group>		mGroups;
+		std::vector<Updating<TClass> *>	mPendingAdds;
+		std::vector<std::pair<Lane *, size_t>>	mTombstones;
+		size_t							mCount {0};
+		unsigned long long				mFrame {0};
 		bool							mInitialized;
+		bool							mInUpdatePass {false};
+		std::mutex *					mPassMutex {nullptr};	///Guards the deferred lists when a pass runs updates on several threads
 
 		friend class Updating<TClass>;
 	};
@@ -170,7 +256,8 @@ namespace KEngineCore {
 	{
 		if (mInitialized)
 		{
-			assert(mUpdateList.empty()); /// The updater is a dependency for any updating objects, must ensure they are cleaned up first
+			assert(mCount == 0); /// The updater is a dependency for any updating objects, must ensure they are cleaned up first
+			mGroups.clear();
 			mInitialized = false;
 		}
 	}
@@ -179,12 +266,57 @@ namespace KEngineCore {
 
 	template <class TClass>
 	void Updater<TClass>::Update(double fTime)
+	{
+		RunUpdatePass(fTime, [] (Lane & lane, double laneTime)
+			{
+				size_t count = lane.size();
+				for (size_t index = 0; index < count; index++)
+				{
+					Updating<TClass> * updateable = lane[index];
+					if (updateable != nullptr)	///Stopped earlier in this pass
+					{
+						updateable->UpdateFromLane(laneTime);
+					}
+				}
+			});
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TClass>
+	size_t Updater<TClass>::GetCount() const
+	{
+		return mCount;
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TClass>
+	template <class TRunLane>
+	void Updater<TClass>::RunUpdatePass(double fTime, TRunLane const & runLane)
 	{
 		assert(mInitialized);
-        for (auto * updateable: mUpdateList)
-        {
-            updateable->Update(fTime);
-        }
+		assert(!mInUpdatePass);
+		mInUpdatePass = true;
+		for (auto & entry : mGroups)
+		{
+			Group & group = entry.second;
+			size_t laneCount = group.mLanes.size();
+			for (double & laneTime : group.mLaneTimes)
+			{
+				laneTime += fTime;
+			}
+			size_t due = (size_t)(mFrame % laneCount);
+			double laneTime = group.mLaneTimes[due];
+			group.mLaneTimes[due] = 0.0;
+			if (!group.mLanes[due].empty())
+			{
+				runLane(group.mLanes[due], laneTime);
+			}
+		}
+		mFrame++;
+		mInUpdatePass = false;
+		FinishUpdatePass();
 	}
 
 	///------------------------------------------------------------------------
@@ -193,7 +325,22 @@ namespace KEngineCore {
 	void Updater<TClass>::AddToUpdateList( Updating<TClass> * updatable )
 	{
 		assert(mInitialized);
-		mUpdateList.push_back(updatable);
+		std::unique_lock<std::mutex> lock;
+		if (mInUpdatePass && mPassMutex != nullptr)
+		{
+			lock = std::unique_lock<std::mutex>(*mPassMutex);
+		}
+		if (mInUpdatePass)
+		{
+			updatable->mPendingAdd = true;
+			updatable->mUpdateIndex = mPendingAdds.size();
+			mPendingAdds.push_back(updatable);
+		}
+		else
+		{
+			Place(updatable);
+		}
+		mCount++;
 	}
 
 	///------------------------------------------------------------------------
@@ -202,7 +349,100 @@ namespace KEngineCore {
 	void Updater<TClass>::RemoveFromUpdateList( Updating<TClass> * updatable )
 	{
 		assert(mInitialized);
-        mUpdateList.erase(remove(mUpdateList.begin(), mUpdateList.end(), updatable));
+		std::unique_lock<std::mutex> lock;
+		if (mInUpdatePass && mPassMutex != nullptr)
+		{
+			lock = std::unique_lock<std::mutex>(*mPassMutex);
+		}
+		size_t index = updatable->mUpdateIndex;
+		Lane * lane = updatable->mLane;
+		updatable->mUpdateIndex = SIZE_MAX;
+		updatable->mLane = nullptr;
+		mCount--;
+		if (updatable->mPendingAdd)
+		{
+			///Started and stopped within the same pass
+			updatable->mPendingAdd = false;
+			mPendingAdds[index] = mPendingAdds.back();
+			mPendingAdds[index]->mUpdateIndex = index;
+			mPendingAdds.pop_back();
+		}
+		else if (mInUpdatePass)
+		{
+			(*lane)[index] = nullptr;
+			mTombstones.emplace_back(lane, index);
+		}
+		else
+		{
+			(*lane)[index] = lane->back();
+			(*lane)[index]->mUpdateIndex = index;
+			lane->pop_back();
+		}
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TClass>
+	void Updater<TClass>::Place(Updating<TClass> * updatable)
+	{
+		Group & group = mGroups[GroupKey(updatable->mPhase, -updatable->mPriority, updatable->mInterval)];
+		if (group.mLanes.empty())
+		{
+			///Never resized after this, so objects can hold on to their lane
+			group.mLanes.resize(updatable->mInterval);
+			group.mLaneTimes.resize(updatable->mInterval, 0.0);
+		}
+		///The emptiest lane, to keep each frame's share of the group even
+		Lane * lane = &group.mLanes[0];
+		for (Lane & candidate : group.mLanes)
+		{
+			if (candidate.size() < lane->size())
+			{
+				lane = &candidate;
+			}
+		}
+		updatable->mLane = lane;
+		updatable->mUpdateIndex = lane->size();
+		updatable->mJoinedLaneTime = group.mLaneTimes[lane - &group.mLanes[0]];
+		lane->push_back(updatable);
+	}
+
+	///------------------------------------------------------------------------
+
+	template <class TClass>
+	void Updater<TClass>::FinishUpdatePass()
+	{
+		for (auto & tombstone : mTombstones)
+		{
+			Lane & lane = *tombstone.first;
+			size_t index = tombstone.second;
+			///Trailing tombstones are simply dropped, which leaves a live entry at the back to fill holes with
+			while (!lane.empty() && lane.back() == nullptr)
+			{
+				lane.pop_back();
+			}
+			if (index < lane.size() && lane[index] == nullptr)
+			{
+				lane[index] = lane.back();
+				lane[index]->mUpdateIndex = index;
+				lane.pop_back();
+			}
+		}
+		mTombstones.clear();
+
+		for (auto * updatable : mPendingAdds)
+		{
+			updatable->mPendingAdd = false;
+			Place(updatable);
+		}
+		mPendingAdds.clear();
+
+		///Drop groups whose last member has left; with nobody in them, nothing holds on to their lanes
+		for (auto it = mGroups.begin(); it != mGroups.end();)
+		{
+			bool empty = std::all_of(it->second.mLanes.begin(), it->second.mLanes.end(), [] (Lane const & lane) { return lane.empty(); });
+			it = empty ? mGroups.erase(it) : std::next(it);
+		}
 	}
 
 	///------------------------------------------------------------------------
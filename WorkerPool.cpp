@@ -0,0 +1,125 @@
+#include "WorkerPool.h"
+#include <assert.h>
+#include <algorithm>
+
+KEngineCore::WorkerPool::WorkerPool()
+{
+}
+
+KEngineCore::WorkerPool::~WorkerPool()
+{
+	Deinit();
+}
+
+void KEngineCore::WorkerPool::Init(unsigned int threadCount)
+{
+	assert(mThreads.empty());
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	mParticipants = threadCount;
+	mShares.reset(new Share[mParticipants]);
+	mQuitting = false;
+	mJob = 0;
+	//Participant 0 is whoever calls ParallelFor
+	for (unsigned int participant = 1; participant < mParticipants; participant++) {
+		mThreads.emplace_back(&WorkerPool::WorkerMain, this, participant);
+	}
+}
+
+void KEngineCore::WorkerPool::Deinit()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuitting = true;
+	}
+	mJobStart.notify_all();
+	for (auto it = mThreads.begin(); it != mThreads.end(); it++) {
+		it->join();
+	}
+	mThreads.clear();
+	mShares.reset();
+	mParticipants = 1;
+}
+
+void KEngineCore::WorkerPool::ParallelFor(size_t count, size_t minChunkSize, RangeFunction const & body)
+{
+	assert(!mRunning);  //Not reentrant
+	minChunkSize = std::max<size_t>(minChunkSize, 1);
+	if (count == 0) {
+		return;
+	}
+	if (mThreads.empty() || count <= minChunkSize) {
+		body(0, count);  //Not worth waking anybody
+		return;
+	}
+
+	//A few chunks per participant leaves something to steal without paying for an atomic per item.  Shares are whole
+	//chunks, and the last chunk absorbs the remainder, so no chunk comes out shorter than minChunkSize.
+	mCount = count;
+	mChunkSize = std::max(minChunkSize, count / (mParticipants * 4));
+	mChunkCount = count / mChunkSize;
+	mShareCount = (unsigned int)std::min<size_t>(mParticipants, mChunkCount);
+	for (unsigned int share = 0; share < mShareCount; share++) {
+		mShares[share].mNext = mChunkCount * share / mShareCount;
+		mShares[share].mEnd = mChunkCount * (share + 1) / mShareCount;
+	}
+	mBody = &body;
+	mRunning = true;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mBusyWorkers = (unsigned int)mThreads.size();
+		mJob++;
+	}
+	mJobStart.notify_all();
+
+	RunShares(0);
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mJobDone.wait(lock, [this] () { return mBusyWorkers == 0; });
+	mRunning = false;
+	mBody = nullptr;
+}
+
+unsigned int KEngineCore::WorkerPool::GetThreadCount() const
+{
+	return mParticipants;
+}
+
+void KEngineCore::WorkerPool::WorkerMain(unsigned int participant)
+{
+	unsigned long long job = 0;
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (true) {
+		mJobStart.wait(lock, [this, &job] () { return mQuitting || mJob != job; });
+		if (mQuitting) {
+			break;
+		}
+		job = mJob;
+		lock.unlock();
+
+		RunShares(participant);
+
+		lock.lock();
+		if (--mBusyWorkers == 0) {
+			mJobDone.notify_one();
+		}
+	}
+}
+
+void KEngineCore::WorkerPool::RunShares(unsigned int participant)
+{
+	//Own share first, then the others' in turn; participants without a share of their own only steal.  Claiming is a
+	//fetch_add, so owner and thieves never take the same chunk.
+	for (unsigned int offset = 0; offset < mShareCount; offset++) {
+		Share & share = mShares[(participant + offset) % mShareCount];
+		while (true) {
+			size_t chunk = share.mNext.fetch_add(1);
+			if (chunk >= share.mEnd) {
+				break;
+			}
+			size_t begin = chunk * mChunkSize;
+			(*mBody)(begin, chunk + 1 == mChunkCount ? mCount : begin + mChunkSize);
+		}
+	}
+}
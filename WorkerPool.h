@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace KEngineCore {
+
+///Fork-join pool for data-parallel loops.  ParallelFor cuts an index range into chunks and deals them evenly between the
+///calling thread and the workers; each takes chunks from its own share and, once that's done, steals from the others, so
+///uneven per-item costs still balance out.  It returns when every index has been handled.
+///
+///One ParallelFor at a time: it's not reentrant, and isn't meant to be called from more than one thread at once.
+class WorkerPool
+{
+public:
+	typedef std::function<void (size_t begin, size_t end)> RangeFunction;
+
+	WorkerPool();
+	~WorkerPool();
+
+	///threadCount includes the calling thread; 0 uses one per hardware thread
+	void Init(unsigned int threadCount = 0);
+	void Deinit();
+
+	///Calls body on disjoint [begin, end) ranges covering [0, count), each at least minChunkSize long unless count itself
+	///is shorter.  The last range takes whatever doesn't divide evenly, rather than leaving a short one.
+	void ParallelFor(size_t count, size_t minChunkSize, RangeFunction const & body);
+
+	unsigned int GetThreadCount() const;
+
+private:
+	///One participant's share of the chunks, as chunk indices.  Padded to a cache line, since every participant hammers its own.
+	struct alignas(64) Share {
+		std::atomic<size_t>	mNext {0};
+		size_t				mEnd {0};
+	};
+
+	void WorkerMain(unsigned int participant);
+	void RunShares(unsigned int participant);
+
+	std::vector<std::thread>	mThreads;
+	std::unique_ptr<Share[]>	mShares;
+	unsigned int				mParticipants {1};
+
+	std::mutex					mMutex;
+	std::condition_variable		mJobStart;
+	std::condition_variable		mJobDone;
+	unsigned long long			mJob {0};
+	unsigned int				mBusyWorkers {0};
+	bool						mQuitting {false};
+
+	RangeFunction const *		mBody {nullptr};
+	size_t						mCount {0};
+	size_t						mChunkSize {1};
+	size_t						mChunkCount {0};
+	unsigned int				mShareCount {0};	///Never more than there are chunks, so no share is left short
+	bool						mRunning {false};
+};
+
+}